@@ -2,13 +2,51 @@
 #include "claujson.h"
 
 #include <future>
+#include <functional>
 
 #include <set>
+#include <deque>
 #include <execution>
 #include <array>
+#include <limits>
 
 #include "fmt/format.h"
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#define CLAUJSON_USE_PWRITE 1
+#else
+#include <io.h>
+#define CLAUJSON_USE_PWRITE 0
+#endif
+
+#if defined(__linux__)
+#include <sched.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CLAUJSON_USE_AVX2 1
+#else
+#define CLAUJSON_USE_AVX2 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CLAUJSON_USE_SSE2 1
+#else
+#define CLAUJSON_USE_SSE2 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 #if __cpp_lib_string_view
 
 #else
@@ -26,7 +64,7 @@
 	namespace claujson {
 
 
-		int64_t Arena::counter = 0;
+		std::atomic<int64_t> Arena::counter{ 0 };
 
 		// todo? make Document class? like simdjson?
 		_Value _Value::empty_value{ nullptr, false }; // valid is false..
@@ -47,6 +85,187 @@
 
 		Log log;
 
+		Log::~Log() {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				stop = true;
+			}
+			condition.notify_all();
+			if (flusher.joinable()) {
+				flusher.join();
+			}
+			std::unique_lock<std::mutex> lock(mutex);
+			drain();
+		}
+
+		void Log::begin(int state) {
+			Local& me = local();
+			if (!me.buf.line.empty()) {
+				commit(me);
+			}
+			const int x = opt2.load(std::memory_order_relaxed);
+			me.on = state == 0 ? (x & Option2::INFO) != 0 : (x & Option2::WARN) != 0;
+			me.begun = true;
+			me.owner = this;
+		}
+
+		void Log::commit(Local& me) {
+			if (!me.ring) {
+				me.ring = std::make_shared<Ring>();
+				std::unique_lock<std::mutex> lock(mutex);
+				rings.push_back(me.ring);
+			}
+			if (!started.load(std::memory_order_acquire)) {
+				start();
+			}
+			if (me.buf.line.size() > Ring::capacity) { // not fit in ring, written here after lines in rings.
+				std::unique_lock<std::mutex> lock(mutex);
+				drain();
+				output(me.buf.line.data(), me.buf.line.size());
+				flush_written();
+				me.buf.line.clear();
+				return;
+			}
+			// full -> wakes flusher and waits a little, then drops the line.
+			for (int i = 0; !me.ring->push(me.buf.line.data(), me.buf.line.size()); ++i) {
+				if (i == 1024) {
+					dropped++;
+					break;
+				}
+				condition.notify_one();
+				std::this_thread::yield();
+			}
+			me.buf.line.clear();
+			if (pending.fetch_add(1) == 0) { // flusher may sleep, lock : not between its check and wait.
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+				}
+				condition.notify_one();
+			}
+		}
+
+		void Log::start() {
+			std::unique_lock<std::mutex> lock(mutex);
+			if (started.load(std::memory_order_relaxed) || stop) {
+				return;
+			}
+			flusher = std::thread([this] {
+				std::unique_lock<std::mutex> lock(mutex);
+				while (true) {
+					condition.wait(lock, [this] { return stop || pending.load() > 0; });
+					if (stop) {
+						break;
+					}
+					pending.store(0); // before drain, a line pushed after this wakes it again.
+					drain();
+				}
+			});
+			started.store(true, std::memory_order_release);
+		}
+
+		void Log::flush() {
+			Local& me = local();
+			if (!me.buf.line.empty()) {
+				commit(me);
+			}
+			std::unique_lock<std::mutex> lock(mutex);
+			drain();
+		}
+
+		void Log::drain() {
+			for (uint64_t i = 0; i < rings.size(); ++i) {
+				const bool closed = rings[i]->closed.load(); // before pop, lines before close are popped.
+				rings[i]->pop([this](const char* data, uint64_t len) { output(data, len); });
+				if (closed) {
+					rings[i] = std::move(rings.back());
+					rings.pop_back();
+					--i;
+				}
+			}
+			const uint64_t n = dropped.exchange(0);
+			if (n > 0) {
+				const std::string x = "[WARN] " + std::to_string(n) + " log lines are dropped, ring buffer is full\n";
+				output(x.data(), x.size());
+			}
+			flush_written();
+		}
+
+		void Log::flush_written() {
+			if (!written) {
+				return;
+			}
+			written = false;
+			if (outFile.is_open()) {
+				outFile.flush();
+			}
+			std::cout.flush();
+		}
+
+		void Log::output(const char* data, uint64_t len) {
+			const Option x = opt.load(std::memory_order_relaxed);
+			if (x == Option::CONSOLE || x == Option::CONSOLE_AND_FILE) {
+				std::cout.write(data, len);
+				written = true;
+			}
+			if (x == Option::FILE || x == Option::CONSOLE_AND_FILE) {
+				if (!outFile.is_open() || outFileName != fileName) {
+					outFile.close();
+					outFile.clear();
+					outFile.open(fileName, std::ios::app);
+					outFileName = fileName;
+				}
+				if (outFile) {
+					outFile.write(data, len);
+					written = true;
+				}
+			}
+		}
+
+		Trace trace;
+
+		bool Trace::write(const std::string& fileName) {
+			const std::vector<Event> x = events();
+			const uint64_t begin = start_time();
+
+			Document d;
+			Arena* pool = d.GetAllocator();
+			_Value arr = Array::Make(pool);
+			arr.as_array()->reserve_data_list(x.size());
+
+			// complete events, ts and dur in microseconds.
+			for (auto& e : x) {
+				_Value event = Object::Make(pool);
+				Object* obj = event.as_object();
+				obj->add_element(_Value(pool, "name"sv), _Value(pool, e.name));
+				obj->add_element(_Value(pool, "ph"sv), _Value(pool, "X"sv));
+				obj->add_element(_Value(pool, "ts"sv), _Value(((double)e.begin - (double)begin) / 1000));
+				obj->add_element(_Value(pool, "dur"sv), _Value((double)(e.end - e.begin) / 1000));
+				obj->add_element(_Value(pool, "pid"sv), _Value(1));
+				obj->add_element(_Value(pool, "tid"sv), _Value(e.tid));
+				if (e.chunk >= 0) {
+					_Value args = Object::Make(pool);
+					args.as_object()->add_element(_Value(pool, "chunk"sv), _Value(e.chunk));
+					obj->add_element(_Value(pool, "args"sv), std::move(args));
+				}
+				arr.as_array()->add_element(std::move(event));
+			}
+
+			d.Get() = Object::Make(pool);
+			d.Get().as_object()->add_element(_Value(pool, "traceEvents"sv), std::move(arr));
+			d.Get().as_object()->add_element(_Value(pool, "displayTimeUnit"sv), _Value(pool, "ns"sv));
+
+			writer w;
+			const std::string str = w.write_to_str(d.Get());
+
+			std::ofstream outFile(fileName, std::ios::binary);
+			if (!outFile) {
+				log << warn << "trace : can not open " << fileName << "\n";
+				return false;
+			}
+			outFile.write(str.data(), str.size());
+			return static_cast<bool>(outFile);
+		}
+
 		StructuredPtr::StructuredPtr(_Value& x) {
 			arr = x.as_array();
 			if (arr) {
@@ -489,6 +708,47 @@
 			return p;
 		}
 
+		uint64_t StructuredPtr::get_node_count() const {
+			if (type == 1) {
+				return arr->_node_count;
+			}
+			if (type == 2) {
+				return obj->_node_count;
+			}
+			return 0;
+		}
+
+		uint64_t StructuredPtr::node_count(const _Value& x) {
+			if (!x.is_structured()) {
+				return 1;
+			}
+			const StructuredPtr ut = x;
+			uint64_t count = ut.get_node_count();
+			if (count != 0) {
+				return count;
+			}
+			count = 1;
+			const uint64_t len = ut.get_data_size();
+			for (uint64_t i = 0; i < len; ++i) {
+				count += node_count(ut.get_value_list(i));
+			}
+			return count;
+		}
+
+		void StructuredPtr::add_node_count(int64_t delta) {
+			// if a node is not known, its parents are not known too.
+			StructuredPtr x = *this;
+			while (x.is_user_type() && x.get_node_count() != 0) {
+				if (x.is_array()) {
+					x.arr->_node_count += delta;
+				}
+				else {
+					x.obj->_node_count += delta;
+				}
+				x = x.get_parent();
+			}
+		}
+
 		std::ostream& operator<<(std::ostream& stream, const claujson::_Value& data) {
 
 			if (false == data.is_valid()) {
@@ -498,13 +758,13 @@
 
 			switch (data._type) {
 			case claujson::_ValueType::INT:
-				stream << data._int_val;
+				stream << data.int_val();
 				break;
 			case claujson::_ValueType::UINT:
-				stream << data._uint_val;
+				stream << data.uint_val();
 				break;
 			case claujson::_ValueType::FLOAT:
-				stream << data._float_val;
+				stream << data.float_val();
 				break;
 			case claujson::_ValueType::STRING:
 			case claujson::_ValueType::SHORT_STRING:
@@ -703,6 +963,90 @@ namespace claujson {
 		}
 	}
 
+	claujson_inline bool need_escape(char ch) {
+		const unsigned char code = ch;
+		return code < 0x20 || code == '\"' || code == '\\' || code == 0x7F;
+	}
+
+	claujson_inline int first_bit(uint32_t x) {
+#if defined(_MSC_VER)
+		unsigned long idx = 0;
+		_BitScanForward(&idx, x);
+		return (int)idx;
+#else
+		return __builtin_ctz(x);
+#endif
+	}
+
+	// first char to escape in [p, end), or end. 32 or 16 bytes at once, then 8 bytes (swar).
+	claujson_inline const char* find_escape(const char* p, const char* end) {
+#if CLAUJSON_USE_AVX2
+		{
+			const __m256i quote = _mm256_set1_epi8('\"');
+			const __m256i back_slash = _mm256_set1_epi8('\\');
+			const __m256i del = _mm256_set1_epi8(0x7F);
+			const __m256i ctrl = _mm256_set1_epi8(0x1F);
+
+			for (; end - p >= 32; p += 32) {
+				const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+				const __m256i m = _mm256_or_si256(
+					_mm256_or_si256(_mm256_cmpeq_epi8(x, quote), _mm256_cmpeq_epi8(x, back_slash)),
+					_mm256_or_si256(_mm256_cmpeq_epi8(x, del), _mm256_cmpeq_epi8(_mm256_max_epu8(x, ctrl), ctrl))); // x <= 0x1F
+				const uint32_t mask = (uint32_t)_mm256_movemask_epi8(m);
+				if (mask) {
+					return p + first_bit(mask);
+				}
+			}
+		}
+#endif
+#if CLAUJSON_USE_SSE2
+		{
+			const __m128i quote = _mm_set1_epi8('\"');
+			const __m128i back_slash = _mm_set1_epi8('\\');
+			const __m128i del = _mm_set1_epi8(0x7F);
+			const __m128i ctrl = _mm_set1_epi8(0x1F);
+
+			for (; end - p >= 16; p += 16) {
+				const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+				const __m128i m = _mm_or_si128(
+					_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, back_slash)),
+					_mm_or_si128(_mm_cmpeq_epi8(x, del), _mm_cmpeq_epi8(_mm_max_epu8(x, ctrl), ctrl)));
+				const uint32_t mask = (uint32_t)_mm_movemask_epi8(m);
+				if (mask) {
+					return p + first_bit(mask);
+				}
+			}
+		}
+#endif
+		{
+			const uint64_t ones = 0x0101010101010101ULL;
+			const uint64_t high = 0x8080808080808080ULL;
+
+			for (; end - p >= 8; p += 8) {
+				uint64_t x;
+				memcpy(&x, p, 8);
+
+				const uint64_t quote = x ^ (ones * '\"');
+				const uint64_t back_slash = x ^ (ones * '\\');
+				const uint64_t del = x ^ (ones * 0x7F);
+
+				// has zero byte, or has byte < 0x20.
+				const uint64_t found = ((quote - ones) & ~quote) | ((back_slash - ones) & ~back_slash)
+					| ((del - ones) & ~del) | ((x - ones * 0x20) & ~x);
+				if (found & high) {
+					break;
+				}
+			}
+		}
+
+		for (; p < end; ++p) {
+			if (need_escape(*p)) {
+				return p;
+			}
+		}
+		return end;
+	}
+
 	claujson_inline 
 	bool ConvertString(Arena* pool, claujson::_Value& data, const char* text, uint64_t len) {
 		uint8_t sbuf[1024 + 1 + _simdjson::_SIMDJSON_PADDING];
@@ -724,6 +1068,7 @@ namespace claujson {
 			*x = '\0';
 			auto string_length = uint32_t(x - string_buf);
 			data.set_str_in_parse(pool, reinterpret_cast<char*>(string_buf), string_length);
+			data.get_string().set_escape_info(find_escape(reinterpret_cast<char*>(string_buf), reinterpret_cast<char*>(x)) != reinterpret_cast<char*>(x));
 		}
 		return true;
 	}
@@ -780,6 +1125,224 @@ namespace claujson {
 		return true;
 	}
 
+	// 8 digits? (SWAR)
+	claujson_inline bool IsEightDigits(const char* text) {
+		uint64_t val;
+		memcpy(&val, text, 8);
+		return (((val & 0xF0F0F0F0F0F0F0F0) | (((val + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333);
+	}
+
+	// 8 digits -> number, need IsEightDigits(text). (SWAR)
+	claujson_inline uint32_t ParseEightDigits(const char* text) {
+		uint64_t val;
+		memcpy(&val, text, 8);
+		val = (val & 0x0F0F0F0F0F0F0F0F) * 2561 >> 8;
+		val = (val & 0x00FF00FF00FF00FF) * 6553601 >> 16;
+		return static_cast<uint32_t>((val & 0x0000FFFF0000FFFF) * 42949672960001 >> 32);
+	}
+
+	claujson_inline bool IsNumberStart(char ch) {
+		return ch == '-' || ('0' <= ch && ch <= '9');
+	}
+
+	// fast path for numbers in array, text has padding.
+	// -?(0|[1-9][0-9]*)(.[0-9]+)? , integer has at most 18 digits, float has at most 15 digits (exact in double)
+	// returns false if not this case, then use Convert.
+	claujson_inline bool ParseSimpleNumber(const char* text, uint64_t len, _Value& data) {
+		static const double power_of_ten[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+			1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+
+		uint64_t i = 0;
+		bool neg = false;
+		if (text[i] == '-') {
+			neg = true;
+			++i;
+		}
+
+		uint64_t w = 0;
+		const uint64_t int_start = i;
+		if (text[i] == '0') {
+			++i;
+		}
+		else {
+			while (IsEightDigits(text + i)) {
+				w = w * 100000000 + ParseEightDigits(text + i);
+				i += 8;
+			}
+			while ('0' <= text[i] && text[i] <= '9') {
+				w = w * 10 + (text[i] - '0');
+				++i;
+			}
+		}
+		const uint64_t int_digits = i - int_start;
+		if (int_digits == 0) {
+			return false;
+		}
+
+		uint64_t frac_digits = 0;
+		if (text[i] == '.') {
+			++i;
+			const uint64_t frac_start = i;
+			while (IsEightDigits(text + i)) {
+				w = w * 100000000 + ParseEightDigits(text + i);
+				i += 8;
+			}
+			while ('0' <= text[i] && text[i] <= '9') {
+				w = w * 10 + (text[i] - '0');
+				++i;
+			}
+			frac_digits = i - frac_start;
+			if (frac_digits == 0) {
+				return false;
+			}
+		}
+
+		if (i > len || text[i] == 'e' || text[i] == 'E') {
+			return false;
+		}
+		for (uint64_t k = i; k < len; ++k) {
+			if (text[k] != ' ' && text[k] != '\t' && text[k] != '\n' && text[k] != '\r') {
+				return false;
+			}
+		}
+
+		if (frac_digits > 0) {
+			if (int_digits + frac_digits > 15) {
+				return false;
+			}
+			double x = static_cast<double>(w) / power_of_ten[frac_digits];
+			data.set_float(neg ? -x : x);
+		}
+		else {
+			if (int_digits > 18 || (neg && w == 0)) { // -0 -> ConvertNumber
+				return false;
+			}
+			data.set_int(neg ? -static_cast<int64_t>(w) : static_cast<int64_t>(w));
+		}
+		return true;
+	}
+
+	// for lazy number, check number and find type without converting.
+	// only for no exponent, integer has at most 18 digits, and length <= 32, others use ConvertNumber.
+	claujson_inline bool ScanSimpleNumber(const char* text, uint64_t len, uint32_t& num_len, _ValueType& type) {
+		uint64_t i = 0;
+
+		if (i < len && text[i] == '-') {
+			++i;
+		}
+
+		const uint64_t int_start = i;
+		if (i < len && text[i] == '0') {
+			++i;
+		}
+		else {
+			while (i < len && '0' <= text[i] && text[i] <= '9') {
+				++i;
+			}
+		}
+		const uint64_t int_digits = i - int_start;
+		if (int_digits == 0) {
+			return false;
+		}
+
+		bool is_float = false;
+		if (i < len && text[i] == '.') {
+			++i;
+			const uint64_t frac_start = i;
+			while (i < len && '0' <= text[i] && text[i] <= '9') {
+				++i;
+			}
+			if (i == frac_start) {
+				return false;
+			}
+			is_float = true;
+		}
+
+		if (i > 32 || (!is_float && int_digits > 18)) {
+			return false;
+		}
+
+		// until next token, only whitespace. (exponent or not valid -> ConvertNumber)
+		for (uint64_t k = i; k < len; ++k) {
+			if (text[k] != ' ' && text[k] != '\t' && text[k] != '\n' && text[k] != '\r') {
+				return false;
+			}
+		}
+
+		num_len = static_cast<uint32_t>(i);
+		type = is_float ? _ValueType::FLOAT : _ValueType::INT;
+		return true;
+	}
+
+	// number text until next token, without keeping the value. json grammar only, (no 01, 1., .5, +1)
+	//  -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)? and white spaces, then range is checked as Convert does.
+	static bool is_valid_number(const char* text, uint64_t len, bool isFirst) {
+		auto digits = [&](uint64_t& i) {
+			const uint64_t start = i;
+			while (i < len && '0' <= text[i] && text[i] <= '9') {
+				++i;
+			}
+			return i > start;
+		};
+
+		uint64_t i = 0;
+		if (i < len && text[i] == '-') {
+			++i;
+		}
+		if (i < len && text[i] == '0') {
+			++i;
+		}
+		else if (!digits(i)) {
+			return false;
+		}
+		if (i < len && text[i] == '.') {
+			++i;
+			if (!digits(i)) {
+				return false;
+			}
+		}
+		if (i < len && (text[i] == 'e' || text[i] == 'E')) {
+			++i;
+			if (i < len && (text[i] == '+' || text[i] == '-')) {
+				++i;
+			}
+			if (!digits(i)) {
+				return false;
+			}
+		}
+		for (; i < len; ++i) {
+			if (text[i] != ' ' && text[i] != '\t' && text[i] != '\n' && text[i] != '\r') {
+				return false;
+			}
+		}
+
+		uint32_t num_len = 0;
+		_ValueType type = _ValueType::NONE;
+		if (ScanSimpleNumber(text, len, num_len, type)) {
+			return true;
+		}
+		claujson::_Value temp;
+		return ConvertNumber(temp, text, len, isFirst);
+	}
+
+	// string token, text[0] is '"', len : until closing '"'. same check as ConvertString (escapes, \u, surrogate pairs),
+	//  and no control chars. temp : for unescaped string.
+	static bool is_valid_string(const char* text, uint64_t len, std::vector<uint8_t>& temp) {
+		if (len < 2 || text[len - 1] != '"') {
+			return false;
+		}
+		for (uint64_t i = 1; i + 1 < len; ++i) {
+			if (static_cast<uint8_t>(text[i]) < 0x20) {
+				return false;
+			}
+		}
+		if (temp.size() < len + _simdjson::_SIMDJSON_PADDING) {
+			temp.resize(len + _simdjson::_SIMDJSON_PADDING);
+		}
+		const uint8_t* x = _simdjson::parse_string(reinterpret_cast<const uint8_t*>(text) + 1, temp.data(), false);
+		return x != nullptr;
+	}
+
 	claujson::_Value& Convert(Arena* pool, claujson::_Value& data, uint64_t buf_idx, uint64_t next_buf_idx, bool key,
 		char* buf, uint64_t token_idx, bool& err) {
 		
@@ -790,7 +1353,11 @@ namespace claujson {
 		
 		switch (ch) {
 		case '"':
-			if (ConvertString(pool, data, &buf[buf_idx], next_buf_idx - buf_idx)) {}
+			if (ConvertString(pool, data, &buf[buf_idx], next_buf_idx - buf_idx)) {
+				if (key) {
+					data.get_string().update_hash(); // keys are compared often.
+				}
+			}
 			else {
 				goto ERR;
 			}
@@ -800,6 +1367,19 @@ namespace claujson {
 		case '1': case '2': case '3': case '4':
 		case '5': case '6': case '7': case '8': case '9':
 		{
+			if (pool && pool->lazy_number) {
+				uint32_t num_len = 0;
+				_ValueType type = _ValueType::NONE;
+				if (ScanSimpleNumber(&buf[buf_idx], next_buf_idx - buf_idx, num_len, type)) {
+					char* text = pool->allocate_heap(num_len);
+					if (text) {
+						memcpy(text, &buf[buf_idx], num_len);
+						data.set_lazy_number_in_parse(text, num_len, type);
+						break;
+					}
+				}
+			}
+
 			if (ConvertNumber(data, &buf[buf_idx], next_buf_idx - buf_idx, token_idx == 0)) {}
 			else {
 				goto ERR;
@@ -962,10 +1542,28 @@ namespace claujson {
 	// class PartialJson, only used in class LoadData2.
 		// todo - rename? PartialNode ?
 
+	// "00" ~ "99", for StrStream::add_uint.
+	static const char str_digits2[] =
+		"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+		"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+		"8081828384858687888990919293949596979899";
+
 	class StrStream {
 	private:
 		//std::string m_buffer;
 		fmt::memory_buffer m_buffer;
+
+		static int count_digits(uint64_t x) {
+			int n = 1;
+			while (true) {
+				if (x < 10) { return n; }
+				if (x < 100) { return n + 1; }
+				if (x < 1000) { return n + 2; }
+				if (x < 10000) { return n + 3; }
+				x /= 10000;
+				n += 4;
+			}
+		}
 	public:
 
 		const char* buf() const {
@@ -980,160 +1578,590 @@ namespace claujson {
 			return *this;
 		}
 
+		// shortest round-trip (fmt "{}", dragonbox), written in place.
 		StrStream& add_float(double x) {
-			fmt::format_to(std::back_inserter(m_buffer), "{:f}", x);
-			//m_buffer.Double(x); // fmt::format_to(std::back_inserter(out), "{:f}", x);
+			const uint64_t size = m_buffer.size();
+			m_buffer.resize(size + 32);
+			char* start = m_buffer.data() + size;
+			char* end = fmt::format_to(start, "{}", x);
+
+			// keep float type, 1 -> 1.0
+			bool is_int = true;
+			for (char* p = start; p < end; ++p) {
+				if (*p == '.' || *p == 'e' || *p == 'n') { // 'n' : nan, inf
+					is_int = false;
+					break;
+				}
+			}
+			if (is_int) {
+				*end++ = '.';
+				*end++ = '0';
+			}
+
+			m_buffer.resize(end - m_buffer.data());
 			return *this;
 		}
 
 		StrStream& add_int(int64_t x) {
-			fmt::format_to(std::back_inserter(m_buffer), "{}", x);
-			//m_buffer.Int64(x); // fmt::format_to(std::back_inserter(out), "{}", x);
-			return *this;
+			if (x < 0) {
+				add_char('-');
+				return add_uint(0 - (uint64_t)x);
+			}
+			return add_uint((uint64_t)x);
 		}
 
+		// two digits at once, from table.
 		StrStream& add_uint(uint64_t x) {
-			fmt::format_to(std::back_inserter(m_buffer), "{}", x);
-			//m_buffer.Uint64(x); // fmt::format_to(std::back_inserter(out), "{}", x);
+			const int n = count_digits(x);
+			const uint64_t size = m_buffer.size();
+			m_buffer.resize(size + n);
+			char* p = m_buffer.data() + size + n;
+
+			while (x >= 100) {
+				const uint64_t d = (x % 100) * 2;
+				x /= 100;
+				*--p = str_digits2[d + 1];
+				*--p = str_digits2[d];
+			}
+			if (x >= 10) {
+				*--p = str_digits2[x * 2 + 1];
+				*--p = str_digits2[x * 2];
+			}
+			else {
+				*--p = (char)('0' + x);
+			}
+			return *this;
+		}
+
+		StrStream& add_1(const char* str, uint64_t len) {
+			m_buffer.append(str, str + len);
 			return *this;
 		}
 
 		StrStream& add_2(const char* str) {
-			while (str[0] != '\0') {
-				add_char(str[0]);
-				++str;
-			}
+			m_buffer.append(str, str + strlen(str));
 			return *this;
 		}
-	};
 
-	class LoadData2 {
-	private:
-		ThreadPool* pool;
-	public:
-		LoadData2(ThreadPool* pool) : pool(pool) {
-			//
+		void clear() { // capacity is not changed.
+			m_buffer.clear();
 		}
-	public:
-		friend class LoadData;
 
-		 uint64_t Size(Array* root) {
-			if (root == nullptr) { return 0; }
-			return _Size(root) + 1;
-		 }
-		 uint64_t Size(Object* root) {
-			 if (root == nullptr) { return 0; }
-			 return _Size(root) + 1;
-		 }
+		void reserve(uint64_t n) {
+			m_buffer.reserve(n);
+		}
+		uint64_t capacity() const {
+			return m_buffer.capacity();
+		}
+	};
 
+	// streaming output, buffers of range i are written after all buffers of range 0 ~ i-1.
+	//  a range can hold at most max_pending buffers not written yet, then it waits.
+	class WriteQueue {
+	public:
+		// buffer of one range, is handed to queue when full.
+		class Sink {
+		public:
+			WriteQueue* queue;
+			uint64_t idx;
+			StrStream* buf;
+		public:
+			Sink(WriteQueue* queue, uint64_t idx) : queue(queue), idx(idx), buf(queue->get_buffer(idx)) {
+				//
+			}
 
-		 uint64_t _Size(Array* root) {
-			if (root == nullptr) {
-				return 0;
+			StrStream& stream() {
+				return *buf;
 			}
-			
 
-			uint64_t len = root->get_data_size();
-			uint64_t x = 0;
+			void check() {
+				if (buf->buf_size() >= queue->buf_size) {
+					queue->push(idx, buf, false);
+					buf = queue->get_buffer(idx);
+				}
+			}
 
-			for (uint64_t i = 0; i < len; ++i) {
+			void finish() {
+				queue->push(idx, buf, true);
+				buf = nullptr;
+			}
+		};
+	private:
+		std::mutex mtx;
+		std::condition_variable cv;
+
+		std::vector<std::deque<StrStream*>> ready;
+		std::vector<uint64_t> pending;
+		std::vector<uint8_t> done;
+		std::vector<StrStream*> free_list;
+		std::vector<std::unique_ptr<StrStream>> all;
+		uint64_t used = 0; // buffers not in free_list.
+		uint64_t cur = 0;
+		OutputSink* direct = nullptr; // one thread only, buffer is written when pushed.
+		bool fail = false;
+
+		std::atomic<uint64_t> next{ 0 }; // next range to take.
+		uint64_t own = std::numeric_limits<uint64_t>::max(); // range run by the flushing thread.
+		std::function<void(const char*, uint64_t)> own_write;
+	public:
+		const uint64_t buf_size;
+		const uint64_t max_pending; // ready buffers of one range.
+		const uint64_t max_buffers; // in use by all ranges, the range being flushed can go over it.
+	public:
+		WriteQueue(uint64_t range_num, uint64_t buf_size, uint64_t max_pending, uint64_t max_buffers, OutputSink* direct = nullptr)
+			: ready(range_num), pending(range_num, 0), done(range_num, 0), direct(direct), buf_size(buf_size), max_pending(max_pending), max_buffers(max_buffers) {
+			//
+		}
+
+		// waits while max_buffers are in use, except for the range being flushed. (it always goes on)
+		//  buffers grow as they are filled, a range of short text does not take buf_size.
+		StrStream* get_buffer(uint64_t idx) {
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [&] { return used < max_buffers || idx <= cur || direct; });
+			++used;
+			if (free_list.empty()) {
+				all.push_back(std::make_unique<StrStream>());
+				return all.back().get();
+			}
+			StrStream* x = free_list.back();
+			free_list.pop_back();
+			return x;
+		}
+
+		// buf is empty.
+		void release(StrStream* buf) {
+			free_list.push_back(buf);
+			--used;
+		}
+
+		// next range of a lane.
+		uint64_t take() {
+			return next++;
+		}
+
+		void push(uint64_t idx, StrStream* buf, bool last) {
+			std::unique_lock<std::mutex> lock(mtx);
+			if (idx == own) { // from the flushing thread, it is the range being flushed.
+				lock.unlock();
+				own_write(buf->buf(), buf->buf_size());
+				lock.lock();
+				buf->clear();
+				release(buf);
+				if (last) {
+					done[idx] = 1;
+				}
+				cv.notify_all();
+				return;
+			}
+			if (direct) {
+				if (!fail && buf->buf_size() > 0) {
+					fail = !direct->write(buf->buf(), buf->buf_size());
+				}
+				buf->clear();
+				release(buf);
+				return;
+			}
+			if (!last) {
+				cv.wait(lock, [&] { return pending[idx] < max_pending; });
+			}
+			ready[idx].push_back(buf);
+			++pending[idx];
+			if (last) {
+				done[idx] = 1;
+			}
+			cv.notify_all();
+		}
+
+		// in order, called by one thread. a range not taken by lanes yet is run here by run(idx),
+		//  so flush does not wait for lanes that are not started. (ex. all pool workers are busy)
+		template <class Write, class Run>
+		void flush(Write write, Run run) {
+			own_write = write;
+			while (true) {
+				StrStream* buf = nullptr;
 				{
-					auto* ptr = root->get_value_list(i).as_array();
-					if (ptr) {
-						x += Size(ptr);
+					std::unique_lock<std::mutex> lock(mtx);
+					while (!(cur >= ready.size() || !ready[cur].empty() || done[cur])) {
+						uint64_t idx = cur;
+						if (next.compare_exchange_strong(idx, idx + 1)) {
+							own = cur;
+							lock.unlock();
+							run(idx);
+							lock.lock();
+							own = std::numeric_limits<uint64_t>::max();
+							continue;
+						}
+						cv.wait(lock);
+					}
+					if (cur >= ready.size()) {
+						return;
+					}
+					if (ready[cur].empty()) {
+						++cur;
+						cv.notify_all(); // producer of new cur may wait for a buffer.
+						continue;
 					}
+					buf = ready[cur].front();
+					ready[cur].pop_front();
 				}
+
+				write(buf->buf(), buf->buf_size());
+
 				{
-					auto* ptr = root->get_value_list(i).as_object();
-					if (ptr) {
-						x += Size(ptr);
-					}
+					std::unique_lock<std::mutex> lock(mtx);
+					buf->clear();
+					release(buf);
+					--pending[cur];
 				}
+				cv.notify_all();
 			}
+		}
 
-			return x;
+		// made, at most max_buffers + max_pending + 1.
+		uint64_t buffer_count() const {
+			return all.size();
+		}
 
+		bool is_fail() const {
+			return fail;
 		}
-		 uint64_t _Size(Object* root) {
-			 if (root == nullptr) {
-				 return 0;
-			 }
+	};
 
-			 uint64_t len = root->get_data_size();
-			 uint64_t x = 0;
+	static std::string escape_for_json_pointer(std::string str);
 
-			 for (uint64_t i = 0; i < len; ++i) {
-				 {
-					 auto* ptr = root->get_value_list(i).as_array();
-					 if (ptr) {
-						 x += Size(ptr);
-					 }
-				 }
-				 {
-					 auto* ptr = root->get_value_list(i).as_object();
-					 if (ptr) {
-						 x += Size(ptr);
-					 }
-				 }
-			 }
+	// NUMA node ids and allowed cpus of them, in order of id.
+	static void numa_topology(std::vector<int>& node_id, std::vector<std::vector<int>>& cpus) {
+		node_id.clear();
+		cpus.clear();
+#if defined(__linux__)
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+			return;
+		}
 
-			 return x;
+		DIR* dir = opendir("/sys/devices/system/node");
+		if (!dir) {
+			return;
+		}
+		std::vector<int> ids;
+		while (dirent* x = readdir(dir)) {
+			int id = 0;
+			if (sscanf(x->d_name, "node%d", &id) == 1) {
+				ids.push_back(id);
+			}
+		}
+		closedir(dir);
+		std::sort(ids.begin(), ids.end());
 
-		 }
+		for (int id : ids) {
+			std::ifstream in("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+			std::string list;
+			std::getline(in, list);
 
-		 uint64_t Size2(const _Value& root) {
-			if (!root.as_array() && !root.as_object()) {
-				return 0;
+			// ex) 0-3,8-11
+			std::vector<int> node_cpus;
+			const char* p = list.c_str();
+			while (*p) {
+				char* q = nullptr;
+				const long a = strtol(p, &q, 10);
+				if (q == p) {
+					break;
+				}
+				long b = a;
+				p = q;
+				if (*p == '-') {
+					b = strtol(p + 1, &q, 10);
+					p = q;
+				}
+				for (long c = a; c <= b && c < CPU_SETSIZE; ++c) {
+					if (CPU_ISSET(c, &allowed)) {
+						node_cpus.push_back(static_cast<int>(c));
+					}
+				}
+				if (*p == ',') {
+					++p;
+				}
+				else {
+					break;
+				}
 			}
 
-			// root is usertype. (is not primitive.)
-			uint64_t len = 0;
-			if (root.is_array()) {
-				len = root.as_array()->get_data_size();
+			if (!node_cpus.empty()) {
+				node_id.push_back(id);
+				cpus.push_back(std::move(node_cpus));
 			}
-			else if (root.is_object()) {
-				len = root.as_object()->get_data_size();
-			}
-			uint64_t x = len;
+		}
+#endif
+	}
 
-			if (root.is_array() && len > 0) {
-				x = x; // VALUE VALUE VALUE
-			}
-			else if (root.is_object() && len > 0) {
-				x = x * 2; // KEY VALUE KEY VALUE
+	std::vector<std::vector<int>> numa_cpus() {
+		std::vector<int> node_id;
+		std::vector<std::vector<int>> cpus;
+		numa_topology(node_id, cpus);
+		return cpus;
+	}
+
+	// node id -> node index of shared pool, -1 : no worker. set when pool is created with SchedulerOption::numa.
+	static std::vector<int> numa_node_index;
+
+	// node index (of shared pool) of page of p, -1 : unknown.
+	static int64_t memory_node(const void* p) {
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+		int node = -1;
+		const unsigned long flags = 1 | 2; // MPOL_F_NODE | MPOL_F_ADDR
+		if (syscall(SYS_get_mempolicy, &node, nullptr, 0UL, p, flags) == 0
+			&& node >= 0 && node < static_cast<int>(numa_node_index.size())) {
+			return numa_node_index[node];
+		}
+#endif
+		return -1;
+	}
+
+	static uint64_t now_ns() {
+		return Trace::now();
+	}
+
+	// task or phase in trace, if trace is on at begin.
+	class TraceScope {
+	private:
+		const char* name;
+		int64_t chunk;
+		uint64_t begin;
+	public:
+		explicit TraceScope(const char* name, int64_t chunk = -1) : name(name), chunk(chunk), begin(trace.enabled() ? now_ns() : 0) {
+			//
+		}
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+		~TraceScope() {
+			if (begin) {
+				trace.add(name, chunk, begin, now_ns());
 			}
+		}
+	};
 
-			x += 2; // (ARRAY or OBJECT), END
-			
-			if (root.is_array()) {
-				for (uint64_t i = 0; i < len; ++i) {
-					if (root.as_array()->get_value_list(i).as_array()) {
-						x -= 1;
-						x += Size2(root.as_array()->get_value_list(i));
-					}
-					else if (root.as_array()->get_value_list(i).as_object()) {
-						x -= 1;
-						x += Size2(root.as_array()->get_value_list(i));
+	// phase from begin to now -> *ns (if not nullptr) and trace (if on). returns now.
+	static uint64_t EndPhase(const char* name, uint64_t begin, uint64_t* ns) {
+		const uint64_t end = now_ns();
+		if (ns) {
+			*ns = end - begin;
+		}
+		if (trace.enabled()) {
+			trace.add(name, -1, begin, end);
+		}
+		return end;
+	}
+
+	// hardware counters of this thread, one group opened at first use, closed at thread exit.
+	class PerfGroup {
+	private:
+		static const int N = 5; // order of PerfCounters.
+		int fd[N];
+		int pos[N]; // in values of group read, -1 : not opened.
+		int n = 0; // opened.
+		int leader = -1;
+
+		PerfGroup() {
+			for (int i = 0; i < N; ++i) {
+				fd[i] = -1;
+				pos[i] = -1;
+			}
+#if defined(__linux__)
+			const uint64_t dtlb = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			const uint32_t type[N] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE };
+			const uint64_t config[N] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+				PERF_COUNT_HW_BRANCH_MISSES, dtlb };
+
+			for (int i = 0; i < N; ++i) {
+				perf_event_attr attr;
+				memset(&attr, 0, sizeof(attr));
+				attr.size = sizeof(attr);
+				attr.type = type[i];
+				attr.config = config[i];
+				attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				// this thread, any cpu.
+				fd[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+				if (fd[i] >= 0) {
+					if (leader < 0) {
+						leader = fd[i];
 					}
+					pos[i] = n++;
 				}
 			}
-			else if (root.is_object()) {
-				for (uint64_t i = 0; i < len; ++i) {
-					if (root.as_object()->get_value_list(i).as_array()) {
-						x -= 1;
-						x += Size2(root.as_object()->get_value_list(i));
-					}
-					else if (root.as_object()->get_value_list(i).as_object()) {
-						x -= 1;
-						x += Size2(root.as_object()->get_value_list(i));
-					}
+#endif
+		}
+		~PerfGroup() {
+#if defined(__linux__)
+			for (int i = N - 1; i >= 0; --i) {
+				if (fd[i] >= 0) {
+					close(fd[i]);
 				}
 			}
+#endif
+		}
+	public:
+		PerfGroup(const PerfGroup&) = delete;
+		PerfGroup& operator=(const PerfGroup&) = delete;
 
+		static PerfGroup& local() {
+			static thread_local PerfGroup x;
 			return x;
 		}
 
-		// find n node.. , need rename..
+		// false : not available.
+		bool read(PerfCounters* x) {
+			if (leader < 0) {
+				return false;
+			}
+#if defined(__linux__)
+			uint64_t buf[3 + N] = { 0 }; // nr, time enabled, time running, values.
+			if (::read(leader, buf, sizeof(buf)) < static_cast<ssize_t>((3 + n) * sizeof(uint64_t))) {
+				return false;
+			}
+			// scaled if counters were multiplexed.
+			const double scale = buf[2] > 0 ? (double)buf[1] / buf[2] : 0;
+			uint64_t* out[N] = { &x->cycles, &x->instructions, &x->llc_misses, &x->branch_misses, &x->dtlb_misses };
+			for (int i = 0; i < N; ++i) {
+				*out[i] = pos[i] >= 0 ? static_cast<uint64_t>(buf[3 + pos[i]] * scale) : 0;
+			}
+			return true;
+#else
+			return false;
+#endif
+		}
+	};
+
+	// adds counters of this thread from ctor to end() to *sum. (nullptr : nothing)
+	class PerfScope {
+	private:
+		PerfCounters* sum;
+		PerfCounters begin;
+	public:
+		explicit PerfScope(PerfCounters* sum) : sum(sum) {
+			if (sum && !PerfGroup::local().read(&begin)) {
+				this->sum = nullptr;
+			}
+		}
+		PerfScope(const PerfScope&) = delete;
+		PerfScope& operator=(const PerfScope&) = delete;
+		~PerfScope() {
+			end();
+		}
+
+		void end() {
+			PerfCounters x;
+			if (sum && PerfGroup::local().read(&x)) {
+				// scaled values can go back a little.
+				auto add = [](uint64_t& s, uint64_t a, uint64_t b) { s += b > a ? b - a : 0; };
+				add(sum->cycles, begin.cycles, x.cycles);
+				add(sum->instructions, begin.instructions, x.instructions);
+				add(sum->llc_misses, begin.llc_misses, x.llc_misses);
+				add(sum->branch_misses, begin.branch_misses, x.branch_misses);
+				add(sum->dtlb_misses, begin.dtlb_misses, x.dtlb_misses);
+			}
+			sum = nullptr;
+		}
+	};
+
+	// counters of chunks, from threads ran them.
+	template <class C>
+	static PerfCounters SumCounters(const std::vector<C>& chunks) {
+		PerfCounters x;
+		for (auto& c : chunks) {
+			x.cycles += c.counters.cycles;
+			x.instructions += c.counters.instructions;
+			x.llc_misses += c.counters.llc_misses;
+			x.branch_misses += c.counters.branch_misses;
+			x.dtlb_misses += c.counters.dtlb_misses;
+		}
+		return x;
+	}
+
+	// resets *stats, total_ns and arena_blocks at end of scope. (nullptr : nothing)
+	template <class S>
+	class StatsScope {
+	private:
+		S* stats;
+		uint64_t start = 0;
+		int64_t blocks = 0;
+	public:
+		// perf_counters : read hardware counters, if they are available on this thread.
+		explicit StatsScope(S* stats, bool perf_counters = false) : stats(stats) {
+			if (stats) {
+				*stats = S();
+				PerfCounters x;
+				stats->perf_counters = perf_counters && PerfGroup::local().read(&x);
+				start = now_ns();
+				blocks = Arena::counter.load();
+			}
+		}
+		StatsScope(const StatsScope&) = delete;
+		StatsScope& operator=(const StatsScope&) = delete;
+		~StatsScope() {
+			if (stats) {
+				stats->total_ns = now_ns() - start;
+				stats->arena_blocks = static_cast<uint64_t>(Arena::counter.load() - blocks);
+			}
+		}
+	};
+
+	// threads and utilization from chunks, ran in `ns`.
+	template <class S, class C>
+	static void SetUtilization(S* stats, const std::vector<C>& chunks, uint64_t ns) {
+		std::vector<int64_t> workers;
+		uint64_t sum = 0;
+		for (auto& x : chunks) {
+			workers.push_back(x.worker);
+			sum += x.ns;
+		}
+		std::sort(workers.begin(), workers.end());
+		stats->threads = std::unique(workers.begin(), workers.end()) - workers.begin();
+		stats->utilization = ns > 0 && stats->threads > 0 ? (double)sum / ((double)ns * stats->threads) : 0;
+	}
+
+	// output bytes of separators of a writer, for EstimateSize. open, close : same for array and object.
+	struct Separators {
+		uint64_t open, close, comma, colon;
+	};
+
+	class LoadData2 {
+	private:
+		ThreadPool* pool;
+		WriteStats* stats = nullptr; // from writer.
+	public:
+		LoadData2(ThreadPool* pool, WriteStats* stats = nullptr) : pool(pool), stats(stats) {
+			//
+		}
+	public:
+		// first duplicate key found in one chunk.
+		struct DupKey {
+			const Object* obj = nullptr;
+			uint64_t idx = 0;
+		};
+
+		bool chk_key_dup = false;
+		std::string dup_key_path; // json pointer, result of chk_key_dup.
+		bool str_heap = false;
+		bool lazy_number = false;
+		AsyncControl* control = nullptr; // from parser or writer, checked between chunks and every 4096 tokens.
+		ParseStats* parse_stats = nullptr; // from parser, if ParseOption::stats.
+	public:
+		friend class LoadData;
+
+		 // upper bound of JsonView count of root, from (cached) node count : 
+		 //  a node is a value, a container adds its END and a key if it is in an object. (calloc-ed, unused tail is not touched.)
+		 uint64_t Size2(const _Value& root) {
+			 if (!root.is_structured()) {
+				 return 0;
+			 }
+			 return 3 * NodeCount(root);
+		 }
+
+		// find n node.. , need rename.. offsets are in node counts, structured children smaller than
+		//  offset[idx] are skipped by their cached node count, not visited.
 		 void Find2(const _Value& root, const uint64_t n, uint64_t& idx, bool chk_hint, uint64_t& _len, my_vector<uint64_t>& offset,
 			 my_vector<uint64_t>& offset2, my_vector<StructuredPtr>& out, my_vector<int>& hint) {
 			if (idx >= n) {
@@ -1161,13 +2189,7 @@ namespace claujson {
 						return;
 					}
 
-					uint64_t sz = 0;
-					if (root.is_array()) {
-						sz = Size(out[idx - 1].arr);
-					}
-					else  if (root.is_object()) {
-						sz = Size(out[idx - 1].obj);
-					}
+					const uint64_t sz = NodeCount(root);
 
 					if (_len < offset2[idx - 1] + sz - 1) {
 						return;
@@ -1201,21 +2223,25 @@ namespace claujson {
 			}
 
 			for (uint64_t i = 0; i < len; ++i) {
-				if (root.is_array() && root.as_array()->get_value_list(i).is_structured()) {
-
-					Find2(root.as_array()->get_value_list(i), n, idx, i < len - 1, _len, offset, offset2, out, hint);
+				const _Value& x = root.is_array() ? root.as_array()->get_value_list(i) : root.as_object()->get_value_list(i);
 
-					if (idx >= n) {
-						return;
+				if (!x.is_structured()) {
+					if (offset[idx] > 1) { // only containers can be out.
+						offset[idx]--;
 					}
+					continue;
 				}
-				else if (root.is_object() && root.as_object()->get_value_list(i).is_structured()) {
 
-					Find2(root.as_object()->get_value_list(i), n, idx, i < len - 1, _len, offset, offset2, out, hint);
+				const uint64_t count = NodeCount(x);
+				if (count < offset[idx]) {
+					offset[idx] -= count;
+					continue;
+				}
 
-					if (idx >= n) {
-						return;
-					}
+				Find2(x, n, idx, i < len - 1, _len, offset, offset2, out, hint);
+
+				if (idx >= n) {
+					return;
 				}
 			}
 		}
@@ -1254,6 +2280,15 @@ namespace claujson {
 				else {
 					out->obj_data = parent.obj->obj_data.Divide(idx + 1);
 				}
+				if (parent.get_node_count() != 0) { // added back by MergeWith in Merge2.
+					int64_t count = 0;
+					for (uint64_t i = 0; i < out->get_data_size(); ++i) {
+						if (!out->get_value_list(i).is_virtual()) { // moved from lower level, already subtracted.
+							count += NodeCount(out->get_value_list(i));
+						}
+					}
+					parent.add_node_count(-count);
+				}
 				/*
 				for (uint64_t i = idx + 1; i < len; ++i) {
 					if (parent.get_value_list(i).is_structured()) {
@@ -1366,8 +2401,7 @@ namespace claujson {
 			auto a = std::chrono::steady_clock::now();
 			uint64_t len = 0;
 			
-			if (j.is_array()) { len = Size(j.as_array()); }
-			else if(j.is_object()) { len = Size(j.as_object()); }
+			len = NodeCount(j);
 
 			auto b= std::chrono::steady_clock::now();
 			auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a); 
@@ -1454,7 +2488,8 @@ namespace claujson {
 			return pos;
 		}
 
-		 int Merge(StructuredPtr next, StructuredPtr ut, StructuredPtr* ut_next)
+		 // merged : if not nullptr, objects that get elements from other chunk are added.
+		 int Merge(StructuredPtr next, StructuredPtr ut, StructuredPtr* ut_next, std::vector<Object*>* merged = nullptr)
 		{
 
 			// check!!
@@ -1490,6 +2525,10 @@ namespace claujson {
 
 				_next.MergeWith(_ut, start_offset);
 
+				if (merged && _next.is_object()) {
+					merged->push_back(_next.obj);
+				}
+
 				if (_ut.get_data_size() > 0 && _ut.get_value_list(0).is_structured() && _ut.get_value_list(0).is_virtual()) {
 					//clean(_ut.get_value_list(0));
 				}
@@ -1586,23 +2625,124 @@ namespace claujson {
 		}
 
 
+		 // json pointer of key_idx-th key in obj, obj`s parents are valid until root.
+		 static std::string MakeJsonPointer(const Object* obj, uint64_t key_idx) {
+			 std::vector<std::string> route;
+			 bool fail = false;
+
+			 route.push_back(escape_for_json_pointer(obj->get_key_list(key_idx).get_string().get_std_string(fail)));
+
+			 StructuredPtr child(obj);
+			 StructuredPtr parent = obj->get_parent();
+
+			 while (parent) {
+				 uint64_t len = parent.get_data_size();
+				 for (uint64_t i = 0; i < len; ++i) {
+					 const _Value& x = parent.get_value_list(i);
+					 if (x.is_structured() && StructuredPtr(x) == child) {
+						 if (parent.is_array()) {
+							 route.push_back(std::to_string(i));
+						 }
+						 else {
+							 route.push_back(escape_for_json_pointer(parent.get_key_list(i).get_string().get_std_string(fail)));
+						 }
+						 break;
+					 }
+				 }
+				 child = parent;
+				 parent = parent.get_parent();
+			 }
+
+			 std::string result;
+			 for (auto iter = route.rbegin(); iter != route.rend(); ++iter) {
+				 result += '/';
+				 result += *iter;
+			 }
+			 return result;
+		 }
+
 		struct TokenTemp { // need to rename.
 			// 
-			int64_t buf_idx;  // buf_idx?
-			int64_t next_buf_idx; // next_buf_idx?
+			int64_t buf_idx = 0;  // buf_idx?
+			int64_t next_buf_idx = 0; // next_buf_idx?
 			//Json
-			uint64_t token_idx; // token_idx?
+			uint64_t token_idx = 0; // token_idx?
 			//
 			bool is_key = false;
 		};
 
+		 // while parsing, open containers keep running node count in _node_count.
+		 static void AddNodeCount(StructuredPtr ut, uint64_t n) {
+			 if (ut.is_array()) {
+				 ut.arr->_node_count += n;
+			 }
+			 else if (ut.is_object()) {
+				 ut.obj->_node_count += n;
+			 }
+		 }
+
+		 // numbers in array, `number , number , ...` from token `first` -> parsed here, not via Convert.
+		 //  (ParseSimpleNumber, others by add_item_type) run ends before token `last`.
+		 //  node count of arr is added, except the first number. returns token index of last number.
+		 static uint64_t ParseNumberRun(Array* arr, char* buf, uint64_t buf_len, _simdjson::internal::dom_parser_implementation* imple,
+			 uint64_t first, uint64_t last, Arena* pool) {
+			 const uint64_t n = imple->n_structural_indexes;
+			 uint64_t j = first;
+			 while (true) {
+				 const uint64_t buf_idx = imple->structural_indexes[j];
+				 const uint64_t next_buf_idx = j + 1 < n ? imple->structural_indexes[j + 1] : buf_len;
+
+				 _Value x;
+				 if (ParseSimpleNumber(&buf[buf_idx], next_buf_idx - buf_idx, x)) {
+					 arr->arr_vec.push_back(std::move(x));
+				 }
+				 else {
+					 arr->add_item_type(buf_idx, next_buf_idx, buf, j, pool);
+				 }
+
+				 if (j + 2 < last && buf[imple->structural_indexes[j + 1]] == ','
+					 && IsNumberStart(buf[imple->structural_indexes[j + 2]])) {
+					 j += 2;
+				 }
+				 else {
+					 break;
+				 }
+			 }
+			 arr->_node_count += (j - first) / 2;
+			 return j;
+		 }
+
+		 // fill node counts not known yet (containers over chunks, virtual..), returns count of x.
+		 static uint64_t FillNodeCount(_Value& x) {
+			 if (!x.is_structured()) {
+				 return 1;
+			 }
+			 StructuredPtr ut = x;
+			 uint64_t count = ut.get_node_count();
+			 if (count != 0) {
+				 return count;
+			 }
+			 count = 1;
+			 const uint64_t len = ut.get_data_size();
+			 for (uint64_t i = 0; i < len; ++i) {
+				 count += FillNodeCount(ut.get_value_list(i));
+			 }
+			 AddNodeCount(ut, count);
+			 return count;
+		 }
+
+		 // cached node count, or count it (not cached, for const and threads).
+		 static uint64_t NodeCount(const _Value& x) {
+			 return StructuredPtr::node_count(x);
+		 }
+
 		 static bool __LoadData(char* buf, uint64_t buf_len,
 			_simdjson::internal::dom_parser_implementation* imple,
 			int64_t token_arr_start, uint64_t token_arr_len, StructuredPtr _global,
 			int start_state, int last_state, // this line : now not used..
 			class StructuredPtr* next, uint64_t* count_vec, 
 
-			 int* err, uint64_t no, Arena* pool)
+			 int* err, uint64_t no, Arena* pool, DupKey* dup, AsyncControl* control)
 		 {
 			try {
 				if (token_arr_len <= 0) {
@@ -1620,8 +2760,17 @@ namespace claujson {
 				StructuredPtr nowUT = global; // use get_parent(), not my_vector<StructuredPtr>
 
 				TokenTemp key;
+				uint64_t next_check = 0; // of control.
 
 				for (uint64_t i = 0; i < token_arr_len; ++i) {
+					if (control && i >= next_check) { // every 4096 tokens.
+						next_check = i + 4096;
+						if (control->is_cancelled()) {
+							*err = -12;
+							return false;
+						}
+					}
+
 					const char type = (buf[imple->structural_indexes[token_arr_start + i]]);
 
 					switch (type) {
@@ -1658,11 +2807,18 @@ namespace claujson {
 									nowUT.add_item_type(key.buf_idx, key.next_buf_idx, 
 										data.buf_idx, data.next_buf_idx, buf,
 										key.token_idx, data.token_idx, pool);
+									AddNodeCount(nowUT, 1);
 									key.is_key = false;
 								}
+								else if (nowUT.is_array() && !pool->lazy_number && IsNumberStart(buf[data.buf_idx])) {
+									i = ParseNumberRun(nowUT.arr, buf, buf_len, imple, token_arr_start + i, token_arr_start + token_arr_len, pool)
+										- token_arr_start;
+									AddNodeCount(nowUT, 1);
+								}
 								else {
 									nowUT.add_item_type(data.buf_idx, data.next_buf_idx,
 										buf, data.token_idx, pool);
+									AddNodeCount(nowUT, 1);
 								}
 							}
 						}
@@ -1752,8 +2908,19 @@ namespace claujson {
 						else {
 							braceNum--;
 
+							// object is opened and closed in this chunk, so it is complete.
+							if (dup && dup->obj == nullptr && nowUT.is_object()) {
+								uint64_t idx = 0;
+								if (nowUT.obj->chk_key_dup(&idx)) {
+									dup->obj = nowUT.obj;
+									dup->idx = idx;
+								}
+							}
+
+							AddNodeCount(nowUT, 1); // + itself, now node count is complete.
+							const uint64_t count = nowUT.get_node_count();
 							nowUT = nowUT.get_parent();
-							
+							AddNodeCount(nowUT, count);
 						}
 					}
 					break;
@@ -1761,6 +2928,16 @@ namespace claujson {
 					}
 				}
 
+				// containers still opened are not complete, their counts are filled after Merge.
+				for (StructuredPtr x = nowUT; x.is_user_type(); x = x.get_parent()) {
+					if (x.is_array()) {
+						x.arr->_node_count = 0;
+					}
+					else {
+						x.obj->_node_count = 0;
+					}
+				}
+
 				if (next) {
 					*next = nowUT;
 				}
@@ -1849,47 +3026,63 @@ namespace claujson {
 					my_vector<StructuredPtr> next(pivots.size() - 1);
 					{
 						memory_pool = std::vector<Arena*>(pivots.size() - 1);
-						for (auto*& x : memory_pool) {
-							x = new Arena();
-						}
-
 						__global = my_vector<StructuredPtr>(pivots.size() - 1);
-						for (uint64_t i = 0; i < __global.size(); ++i) {
-							__global[i] = (new PartialJson(memory_pool[i]));
-						}
 
-						my_vector<std::future<bool>> result(pivots.size() - 1);
 						my_vector<int> err(pivots.size() - 1);
-						
-						
-
-						{
-							int64_t idx = pivots[1] - pivots[0];
-							int64_t _token_arr_len = idx;
-
+						my_vector<DupKey> dup(pivots.size() - 1);
 
-							result[0] = pool->enqueue(__LoadData, (buf), buf_len, (imple), start[0], _token_arr_len, (__global[0]), 0, 0,
-								&next[0], count_vec,
+						auto a = std::chrono::steady_clock::now();
 
-								&err[0], 0, memory_pool[0]);
+						// chunk i on node i * nodes / chunks, its arena is allocated by the thread building it. (first touch)
+						const uint64_t chunk_num = pivots.size() - 1;
+						const bool perf = parse_stats && parse_stats->perf_counters;
+						if (parse_stats) {
+							parse_stats->build_chunks.resize(chunk_num);
+							parse_stats->arenas = chunk_num;
 						}
+						const uint64_t build_start = now_ns();
+						pool->parallel_for_node(0, chunk_num, [&](size_t i) { return i * pool->node_count() / chunk_num; }, [&](size_t i) {
+							TraceScope scope("__LoadData", i);
+							PerfScope perf_scope(perf ? &parse_stats->build_chunks[i].counters : nullptr);
+							const uint64_t chunk_start = parse_stats ? now_ns() : 0;
+							memory_pool[i] = new Arena();
+							memory_pool[i]->use_str_heap = str_heap;
+							memory_pool[i]->lazy_number = lazy_number;
+							__global[i] = (new PartialJson(memory_pool[i]));
 
-						auto a = std::chrono::steady_clock::now();
+							if (control && control->is_cancelled()) {
+								err[i] = -12;
+								return;
+							}
 
-						for (uint64_t i = 1; i < pivots.size() - 1; ++i) {
 							int64_t _token_arr_len = pivots[i + 1] - pivots[i];
 
-							result[i] = pool->enqueue(__LoadData, (buf), buf_len, (imple), pivots[i], _token_arr_len, (__global[i]), 0, 0,
+							__LoadData((buf), buf_len, (imple), i == 0 ? start[0] : pivots[i], _token_arr_len, (__global[i]), 0, 0,
 								&next[i], count_vec,
 
-								& err[i], i, memory_pool[i]);
+								&err[i], i, memory_pool[i], chk_key_dup ? &dup[i] : nullptr, control);
 
+							if (control || parse_stats) {
+								const uint64_t first = imple->structural_indexes[i == 0 ? start[0] : pivots[i]];
+								const uint64_t last = (uint64_t)pivots[i + 1] < imple->n_structural_indexes ? imple->structural_indexes[pivots[i + 1]] : buf_len;
+								if (control) {
+									control->done += last - first;
+								}
+								if (parse_stats) {
+									ParseStats::Chunk& c = parse_stats->build_chunks[i];
+									c.tokens = _token_arr_len;
+									c.bytes = last - first;
+									c.ns = now_ns() - chunk_start;
+									c.worker = pool->worker_index();
+								}
+							}
+						});
+						EndPhase("build", build_start, parse_stats ? &parse_stats->build_ns : nullptr);
+						if (perf) {
+							parse_stats->build_counters = SumCounters(parse_stats->build_chunks);
 						}
-
-
-						// wait
-						for (uint64_t i = 0; i < result.size(); ++i) {
-							result[i].get();
+						if (parse_stats) {
+							SetUtilization(parse_stats, parse_stats->build_chunks, parse_stats->build_ns);
 						}
 
 						auto b = std::chrono::steady_clock::now();
@@ -1905,6 +3098,10 @@ namespace claujson {
 							case -11:
 								return false;
 								break;
+							case -12:
+								log << info << "cancelled\n";
+								throw 12;
+								break;
 							case -1:
 							case -4:
 								log << warn << "Syntax Error\n"; return false;
@@ -1922,6 +3119,9 @@ namespace claujson {
 						}
 
 						// Merge
+						std::vector<Object*> merged;
+						const uint64_t merge_start = now_ns();
+						PerfScope merge_perf(perf ? &parse_stats->merge_counters : nullptr);
 
 						{
 							int i = 0;
@@ -1970,7 +3170,7 @@ namespace claujson {
 							}
 
 
-							int err = Merge(_global, __global[start], &next[start]);
+							int err = Merge(_global, __global[start], &next[start], chk_key_dup ? &merged : nullptr);
 							if (-1 == err || (pivots.size() == 0 && 1 == err)) {
 								log << warn << "not valid file3\n";
 								throw 3;
@@ -1991,7 +3191,7 @@ namespace claujson {
 									}
 								}
 
-								int err = Merge(next[before], __global[i], &next[i]);
+								int err = Merge(next[before], __global[i], &next[i], chk_key_dup ? &merged : nullptr);
 
 								if (-1 == err) {
 									log << warn << "chk " << i << " " << __global.size() << "\n";
@@ -2004,11 +3204,14 @@ namespace claujson {
 								}
 							}
 
+							const uint64_t link_start = EndPhase("merge", merge_start, parse_stats ? &parse_stats->merge_ns : nullptr);
+							merge_perf.end();
 							_global_memory_pool->link_from(memory_pool[start]);
 							for (uint64_t i = start + 1; i <= last; ++i) {
 								if (chk[i]) { delete memory_pool[i]; memory_pool[i] = nullptr; continue; }
 								_global_memory_pool->link_from(memory_pool[i]);
 							}
+							EndPhase("link", link_start, parse_stats ? &parse_stats->link_ns : nullptr);
 						}
 						//catch (...) {
 							//throw "in Merge, error";
@@ -2024,17 +3227,46 @@ namespace claujson {
 						auto c = std::chrono::steady_clock::now();
 						auto dur2 = std::chrono::duration_cast<std::chrono::milliseconds>(c - b);
 						log << info << "parse2 " << dur2.count() << "ms\n";
-					}
-					}
-					auto a = std::chrono::steady_clock::now();
 
+						const uint64_t finish_start = now_ns();
+						if (_global.get_value_list(0).is_structured()) {
+							StructuredPtr x = _global.get_value_list(0);
+							x.set_parent({});
+							FillNodeCount(_global.get_value_list(0));
+						}
 
-					if (_global.get_value_list(0).is_structured()) {
-						StructuredPtr x = _global.get_value_list(0);
-						x.set_parent({});
-					}
-
-					global = std::move(_global.get_value_list(0));
+						if (chk_key_dup) {
+							// objects in one chunk are checked in __LoadData, remains are objects over chunks.
+							const Object* dup_obj = nullptr;
+							uint64_t dup_idx = 0;
+							for (uint64_t i = 0; i < dup.size(); ++i) {
+								if (dup[i].obj) {
+									dup_obj = dup[i].obj;
+									dup_idx = dup[i].idx;
+									break;
+								}
+							}
+							if (!dup_obj) {
+								std::sort(merged.begin(), merged.end());
+								merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+								for (auto* x : merged) {
+									if (x->chk_key_dup(&dup_idx)) {
+										dup_obj = x;
+										break;
+									}
+								}
+							}
+							if (dup_obj) {
+								dup_key_path = MakeJsonPointer(dup_obj, dup_idx);
+								log << warn << "duplicate key : " << dup_key_path << "\n";
+							}
+						}
+						EndPhase("finish", finish_start, parse_stats ? &parse_stats->finish_ns : nullptr);
+					}
+					}
+					auto a = std::chrono::steady_clock::now();
+
+					global = std::move(_global.get_value_list(0));
 
 
 					auto b = std::chrono::steady_clock::now();
@@ -2055,7 +3287,7 @@ namespace claujson {
 					_global.Delete();
 				}
 
-				return true;
+				return dup_key_path.empty();
 			}
 			catch (int err) {
 
@@ -2129,25 +3361,280 @@ namespace claujson {
 				thr_num);
 		}
 
+		 // in one thread, checks syntax and builds in pool at once. (no chunks, count_vec, Merge)
+		 //  if not valid, nodes made so far stay in pool until it is gone.
+		 bool parse_small(_Value& global, Arena* pool, char* buf, uint64_t buf_len,
+			 _simdjson::internal::dom_parser_implementation* imple) {
+			 const uint64_t n = imple->n_structural_indexes;
+
+			 // what is expected at next token.
+			 enum { VALUE, FIRST_VALUE, KEY, FIRST_KEY, NEXT } state = VALUE;
+
+			 _Value root;
+			 StructuredPtr nowUT; // innermost opened container.
+			 uint64_t depth = 0;
+			 bool done = false; // root value is complete.
+			 TokenTemp key;
+			 const Object* dup_obj = nullptr;
+			 uint64_t dup_idx = 0;
+			 uint64_t next_check = 0; // of control.
+			 TraceScope scope("parse_small");
+			 const uint64_t build_start = parse_stats ? now_ns() : 0;
+			 PerfScope build_perf(parse_stats && parse_stats->perf_counters ? &parse_stats->build_counters : nullptr);
+
+			 const bool backup_str_heap = pool->use_str_heap;
+			 const bool backup_lazy_number = pool->lazy_number;
+			 pool->use_str_heap = str_heap;
+			 pool->lazy_number = lazy_number;
+
+			 try {
+				 for (uint64_t i = 0; i < n; ++i) {
+					 if (done) {
+						 throw 1; // ex) [1]]
+					 }
+					 if (control && i >= next_check) { // every 4096 tokens.
+						 next_check = i + 4096;
+						 control->done = imple->structural_indexes[i];
+						 if (control->is_cancelled()) {
+							 throw "cancelled";
+						 }
+					 }
+
+					 const uint64_t buf_idx = imple->structural_indexes[i];
+					 const uint64_t next_buf_idx = i + 1 < n ? imple->structural_indexes[i + 1] : buf_len;
+					 const char type = buf[buf_idx];
+					 bool close = false;
+
+					 switch (state) {
+					 case FIRST_KEY:
+						 if (type == '}') {
+							 close = true;
+							 break;
+						 }
+						 // fallthrough
+					 case KEY:
+						 if (type != '"' || i + 1 >= n || buf[imple->structural_indexes[i + 1]] != ':') {
+							 throw 2;
+						 }
+						 key.buf_idx = buf_idx;
+						 key.next_buf_idx = next_buf_idx;
+						 key.token_idx = i;
+						 key.is_key = true;
+						 ++i; // pass :
+						 state = VALUE;
+						 break;
+					 case FIRST_VALUE:
+						 if (type == ']') {
+							 close = true;
+							 break;
+						 }
+						 // fallthrough
+					 case VALUE:
+						 if (type == '{' || type == '[') {
+							 if (depth == 0) {
+								 root = type == '{' ? Object::Make(pool) : Array::Make(pool);
+								 nowUT = root;
+							 }
+							 else {
+								 if (key.is_key) {
+									 nowUT.add_user_type(key.buf_idx, key.next_buf_idx, buf,
+										 type == '{' ? _ValueType::OBJECT : _ValueType::ARRAY, key.token_idx, pool);
+									 key.is_key = false;
+								 }
+								 else {
+									 nowUT.add_user_type(type == '{' ? _ValueType::OBJECT : _ValueType::ARRAY, pool);
+								 }
+								 nowUT = nowUT.get_value_list(nowUT.get_data_size() - 1);
+							 }
+							 ++depth;
+							 state = type == '{' ? FIRST_KEY : FIRST_VALUE;
+						 }
+						 else if (type == ',' || type == ':' || type == '}' || type == ']') {
+							 throw 3;
+						 }
+						 else if (depth == 0) { // root is not array or object.
+							 bool e = false;
+							 claujson::Convert(pool, root, buf_idx, next_buf_idx, false, buf, i, e);
+							 if (e) {
+								 throw 4;
+							 }
+							 done = true;
+						 }
+						 else {
+							 if (key.is_key) {
+								 nowUT.add_item_type(key.buf_idx, key.next_buf_idx, buf_idx, next_buf_idx, buf,
+									 key.token_idx, i, pool);
+								 key.is_key = false;
+							 }
+							 else if (nowUT.is_array() && !pool->lazy_number && IsNumberStart(type)) {
+								 i = ParseNumberRun(nowUT.arr, buf, buf_len, imple, i, n, pool);
+							 }
+							 else {
+								 nowUT.add_item_type(buf_idx, next_buf_idx, buf, i, pool);
+							 }
+							 AddNodeCount(nowUT, 1);
+							 state = NEXT;
+						 }
+						 break;
+					 case NEXT:
+						 if (type == ',') {
+							 state = nowUT.is_object() ? KEY : VALUE;
+						 }
+						 else if (type == (nowUT.is_object() ? '}' : ']')) {
+							 close = true;
+						 }
+						 else {
+							 throw 5;
+						 }
+						 break;
+					 }
+
+					 if (close) {
+						 if (chk_key_dup && dup_obj == nullptr && nowUT.is_object()) {
+							 uint64_t idx = 0;
+							 if (nowUT.obj->chk_key_dup(&idx)) {
+								 dup_obj = nowUT.obj;
+								 dup_idx = idx;
+							 }
+						 }
+
+						 AddNodeCount(nowUT, 1); // + itself.
+						 --depth;
+						 if (depth == 0) {
+							 done = true;
+						 }
+						 else {
+							 const uint64_t count = nowUT.get_node_count();
+							 nowUT = nowUT.get_parent();
+							 AddNodeCount(nowUT, count);
+							 state = NEXT;
+						 }
+					 }
+				 }
+
+				 if (!done) {
+					 throw 6; // ex) [1,
+				 }
+			 }
+			 catch (int err) {
+				 log << warn << "not valid json " << err << "\n";
+				 pool->use_str_heap = backup_str_heap;
+				 pool->lazy_number = backup_lazy_number;
+				 return false;
+			 }
+			 catch (const char* err) {
+				 log << warn << err << "\n";
+				 pool->use_str_heap = backup_str_heap;
+				 pool->lazy_number = backup_lazy_number;
+				 return false;
+			 }
+			 catch (...) {
+				 log << warn << "internal error or new error \n";
+				 pool->use_str_heap = backup_str_heap;
+				 pool->lazy_number = backup_lazy_number;
+				 return false;
+			 }
+
+			 pool->use_str_heap = backup_str_heap;
+			 pool->lazy_number = backup_lazy_number;
+
+			 if (parse_stats) { // one chunk, validated while built.
+				 ParseStats::Chunk c;
+				 c.tokens = n;
+				 c.bytes = buf_len;
+				 c.ns = now_ns() - build_start;
+				 c.worker = LoadData2::pool->worker_index();
+				 build_perf.end();
+				 c.counters = parse_stats->build_counters;
+				 parse_stats->build_ns = c.ns;
+				 parse_stats->build_chunks.push_back(c);
+				 SetUtilization(parse_stats, parse_stats->build_chunks, parse_stats->build_ns);
+			 }
+
+			 global = std::move(root);
+
+			 if (global.is_structured()) {
+				 StructuredPtr x = global;
+				 x.set_parent({});
+			 }
+			 if (dup_obj) {
+				 dup_key_path = MakeJsonPointer(dup_obj, dup_idx);
+				 log << warn << "duplicate key : " << dup_key_path << "\n";
+			 }
+
+			 return dup_key_path.empty();
+		 }
+
 	private:
 		//                         
 		 static void _write(StrStream& stream, const _Value& data, my_vector<StructuredPtr>& chk_list, const int depth, bool pretty);
 		 static void _write(StrStream& stream, const _Value& data, const int depth, bool pretty);
 
-		 static void write_(StrStream& stream, const _Value& global, StructuredPtr temp, bool pretty, bool hint);
+		 // chunk : index in trace.
+		 static void write_(StrStream& stream, const _Value& global, StructuredPtr temp, bool pretty, bool hint, uint64_t chunk);
 
 	public:
 		// test?... just Data has one element 
-		 void write(const std::string& fileName, const _Value& global, bool pretty, bool hint = false);
+		 bool write(const std::string& fileName, const _Value& global, bool pretty, bool hint = false);
 
 		 void write(std::ostream& stream, const _Value& data, bool pretty);
 
 		 std::string write_to_str(const _Value& data, bool pretty);
 		 std::string write_to_str2(const _Value& data, bool pretty);
 
-		 void write_parallel(Arena* pool, const std::string& fileName, _Value& j, uint64_t thr_num, bool pretty);
-		 void write_parallel2(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty);
+		 // if sink is not nullptr, output goes to sink. (fileName is not used) false if output fails.
+		 bool write_parallel(Arena* pool, const std::string& fileName, _Value& j, uint64_t thr_num, bool pretty, OutputSink* sink = nullptr);
+		 bool write_parallel2(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty, OutputSink* sink = nullptr);
+		 bool write_parallel3(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty, OutputSink* sink = nullptr);
+
+		 // in chunks.
+		 bool write(OutputSink& sink, const _Value& global, bool pretty);
+
+	private:
+		// part of output, children [begin, end) of data, or fixed text if data is nullptr.
+		struct WriteRange {
+			const _Value* data = nullptr;
+			uint64_t begin = 0;
+			uint64_t end = 0;
+			std::string text;
+		};
+
+		 static void SplitWriteRange(const _Value& data, uint64_t want, bool pretty, std::vector<WriteRange>& out);
+		 static void write_range(StrStream& stream, const WriteRange& range, bool pretty);
+
+		 // approximate output size, from node counts and sampled values.
+		 static uint64_t EstimateSize(const _Value& data, const Separators& sep);
+		 static uint64_t EstimateSize(const WriteRange& range, const Separators& sep, uint64_t budget = 8192);
+		 // reserve estimated size (+ 1/8, sampling error was up to 5% on test inputs), and count it in stats. returns capacity.
+		 uint64_t presize(StrStream& stream, uint64_t estimate);
+		 // count real output size in stats, capacity : from presize.
+		 void add_write_stats(const StrStream& stream, uint64_t capacity);
+
+		 static void _write_stream(WriteQueue::Sink& sink, const _Value& data, bool pretty);
+		 static void write_range_stream(WriteQueue* queue, uint64_t idx, const WriteRange& range, bool pretty);
+
+		 static bool pwrite_all(int fd, const char* buf, uint64_t len, uint64_t offset);
+		 // stream[i] is written at (sum of size of stream[0 ~ i-1]), in parallel if possible.
+		 bool write_file(const std::string& fileName, const my_vector<StrStream>& stream);
+
+		 bool write_out(const std::string& fileName, OutputSink* sink, const my_vector<StrStream>& stream);
+		 bool write_serial(const std::string& fileName, OutputSink* sink, const _Value& j, bool pretty);
+
+	public:
+		 bool write_parallel_stream(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty, uint64_t buf_size, OutputSink* sink = nullptr);
 
+		 // no tree, from structural indexes of valid json. in thr_num chunks, in parallel.
+		 //  false if root value ends before last token or is not closed, a string, number or true/false/null is not valid,
+		 //  or output fails. ex) [1]], [[], [-], tru
+		 bool reformat(const char* buf, uint64_t buf_len, _simdjson::internal::dom_parser_implementation* imple,
+			 uint64_t thr_num, bool pretty, const std::string& fileName, OutputSink* sink);
+	private:
+		 // tokens [start, last), structural chars -> same text as writer, strings and numbers are copied as they are.
+		 //  depth : change of depth in chunk, min_depth : min depth after each token (except last token of json), from 0.
+		 //  false if a string, number or true/false/null is not valid. (is_valid_string, is_valid_number, atoms)
+		 static bool reformat_chunk(StrStream& stream, const char* buf, uint64_t buf_len,
+			 _simdjson::internal::dom_parser_implementation* imple, uint64_t start, uint64_t last, bool pretty,
+			 int64_t* depth, int64_t* min_depth);
 	};
 
 	claujson_inline void _write_string(StrStream& stream, char ch) {
@@ -2180,24 +3667,43 @@ namespace claujson {
 			{
 				char buf[] = "\\uDDDD";
 				snprintf(buf + 2, 5, "%04X", code);
-				stream.add_2(buf);
+				stream.add_1(buf, 6);
 			}
 			else {
-				char buf[] = { ch, '\0' };
-				stream.add_2(buf);
+				stream.add_char(ch);
 			}
 		}
 		}
 	}
 
+	// copy clean runs at once, escape only where needed.
 	claujson_inline void write_string(StrStream& stream, const StringView str) {
+		const char* p = str.data();
+		const char* end = p + str.size();
+
 		stream.add_char('\"');
-		for (uint64_t i = 0; i < str.size(); ++i) {
-			_write_string(stream, str[i]);
+		while (p < end) {
+			const char* x = find_escape(p, end);
+			stream.add_1(p, x - p);
+			if (x == end) {
+				break;
+			}
+			_write_string(stream, *x);
+			p = x + 1;
 		}
 		stream.add_char('\"');
 	}
 
+	claujson_inline void write_string(StrStream& stream, const String& str) {
+		if (str.escape_info() == 1) { // no char to escape, just copy.
+			stream.add_char('\"');
+			stream.add_1(str.data(), str.size());
+			stream.add_char('\"');
+			return;
+		}
+		write_string(stream, StringView(str.data(), str.size()));
+	}
+
 	static    const char* str_open_array[] = { "[", " [ \n",  };
 	static   const  char* str_open_object[] = { "{", " { \n",  };
 	static   const  char* str_close_array[] = { "]", " ] \n", };
@@ -2205,16 +3711,24 @@ namespace claujson {
 	static   const  char* str_comma[] = { ",", " , " };
 	static   const  char* str_colon[] = { ":", " : " };
 	static   const  char* str_space[] = { "", " " };
+	// of str_ above, not pretty / pretty. (write_to_str, write, write_parallel, write_parallel3, ..)
+	static const Separators str_separators[] = { { 1, 1, 1, 1 }, { 4, 4, 3, 3 } };
+	// of print / print_pretty. (write_to_str2, write_parallel2)
+	static const Separators view_separators[] = { { 1, 1, 1, 1 }, { 2, 2, 2, 3 } };
 
 	claujson_inline void write_primitive(StrStream& stream, const _Value& x) {
 		if (x.is_str()) {
 
-			write_string(stream, StringView(x.str_val().data(), x.str_val().size()));
+			write_string(stream, x.str_val());
 
 		}
 		else if (x.type() == _ValueType::BOOL) {
 			stream.add_2(x.bool_val() ? "true" : "false");
 		}
+		else if (x.is_lazy_number()) { // not modified, original text.
+			StringView text = x.get_number_text();
+			stream.add_1(text.data(), text.size());
+		}
 		else if (x.type() == _ValueType::FLOAT) {
 			stream.add_float(x.float_val());
 		}
@@ -2230,6 +3744,7 @@ namespace claujson {
 	}
 	std::string LoadData2::write_to_str(const _Value& global, bool pretty) {
 		StrStream stream;
+		const uint64_t capacity = presize(stream, EstimateSize(global, str_separators[pretty ? 1 : 0]));
 
 		if (global.is_structured()) {
 			bool is_arr = global.is_array();
@@ -2256,6 +3771,8 @@ namespace claujson {
 			write_primitive(stream, x);
 		}
 
+		add_write_stats(stream, capacity);
+
 		return std::string(stream.buf(), stream.buf_size());
 	}
 
@@ -2277,7 +3794,7 @@ namespace claujson {
 					auto& x = ut.get_key_list(i);
 
 					if (x.is_str()) {
-						write_string(stream, StringView(x.str_val().data(), x.str_val().size()));
+						write_string(stream, x.str_val());
 
 						{
 							stream.add_2(str_colon[pretty ? 1 : 0]);
@@ -2309,7 +3826,7 @@ namespace claujson {
 					auto& x = ut.get_key_list(i);
 
 					if (x.is_str()) {
-						write_string(stream, StringView(x.str_val().data(), x.str_val().size()));
+						write_string(stream, x.str_val());
 
 						{
 							stream.add_2(str_colon[pretty ? 1 : 0]); // " : ";
@@ -2395,7 +3912,7 @@ namespace claujson {
 
 						uint64_t len = x.str_val().size();
 
-						write_string(stream, StringView(x.str_val().data(), x.str_val().size()));
+						write_string(stream, x.str_val());
 
 
 						{
@@ -2431,7 +3948,7 @@ namespace claujson {
 				
 
 						uint64_t len = x.str_val().size();
-						write_string(stream, StringView(x.str_val().data(), x.str_val().size()));
+						write_string(stream, x.str_val());
 
 
 
@@ -2499,8 +4016,9 @@ namespace claujson {
 	}
 
 	// todo... just Data has one element 
-	void LoadData2::write(const std::string& fileName, const _Value& global, bool pretty, bool hint) {
+	bool LoadData2::write(const std::string& fileName, const _Value& global, bool pretty, bool hint) {
 		StrStream stream;
+		const uint64_t capacity = presize(stream, EstimateSize(global, str_separators[pretty ? 1 : 0]));
 
 		if (global.is_structured()) {
 			if (hint) {
@@ -2534,12 +4052,19 @@ namespace claujson {
 			write_primitive(stream, x);
 		}
 
+		add_write_stats(stream, capacity);
+
 		std::ofstream outFile;
 		outFile.open(fileName, std::ios::binary); // binary!
 		if (outFile) {
 			outFile.write(stream.buf(), stream.buf_size());
 			outFile.close();
 		}
+		if (!outFile) {
+			log << warn << "write fail " << fileName << "\n";
+			return false;
+		}
+		return true;
 	}
 
 	void LoadData2::write(std::ostream& stream, const _Value& data, bool pretty) {
@@ -2548,7 +4073,8 @@ namespace claujson {
 		stream << StringView(str_stream.buf(), str_stream.buf_size());
 	}
 
-	void LoadData2::write_(StrStream& stream, const _Value& global, StructuredPtr temp, bool pretty, bool hint) {
+	void LoadData2::write_(StrStream& stream, const _Value& global, StructuredPtr temp, bool pretty, bool hint, uint64_t chunk) {
+		TraceScope scope("write_", chunk);
 
 		my_vector<StructuredPtr> chk_list; // point for division?, virtual nodes? }}}?
 
@@ -2595,11 +4121,97 @@ namespace claujson {
 	}
 
 
-	void LoadData2::write_parallel(Arena* memory_pool, const std::string& fileName, _Value& j, uint64_t thr_num, bool pretty) {
+	bool LoadData2::pwrite_all(int fd, const char* buf, uint64_t len, uint64_t offset) {
+#if CLAUJSON_USE_PWRITE
+		while (len > 0) {
+			ssize_t n = ::pwrite(fd, buf, len, (off_t)offset);
+			if (n < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return false;
+			}
+			buf += n;
+			len -= n;
+			offset += n;
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	bool LoadData2::write_file(const std::string& fileName, const my_vector<StrStream>& stream) {
+#if CLAUJSON_USE_PWRITE
+		my_vector<uint64_t> offset(stream.size() + 1);
+
+		offset[0] = 0;
+		for (uint64_t i = 0; i < stream.size(); ++i) {
+			offset[i + 1] = offset[i] + stream[i].buf_size();
+		}
+
+		int fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			log << warn << "open fail " << fileName << "\n";
+			return false;
+		}
+
+		if (offset.back() > 0) {
+			// reserve blocks first, if not supported then just set size.
+			bool reserved = false;
+#if defined(__linux__)
+			reserved = ::posix_fallocate(fd, 0, (off_t)offset.back()) == 0;
+#endif
+			if (!reserved && ::ftruncate(fd, (off_t)offset.back()) != 0) {
+				log << warn << "ftruncate fail " << fileName << "\n";
+				::close(fd);
+				return false;
+			}
+		}
+
+		my_vector<int> thr_result(stream.size());
+
+		pool->parallel_for(0, stream.size(), [&](size_t i) {
+			TraceScope scope("pwrite", i);
+			thr_result[i] = stream[i].buf_size() == 0 || pwrite_all(fd, stream[i].buf(), stream[i].buf_size(), offset[i]);
+		});
+
+		bool ok = true;
+		for (uint64_t i = 0; i < stream.size(); ++i) {
+			ok = thr_result[i] && ok;
+		}
+
+		if (!ok) {
+			log << warn << "pwrite fail " << fileName << "\n";
+		}
+
+		if (::close(fd) != 0 && ok) { // delayed write error.
+			log << warn << "close fail " << fileName << "\n";
+			ok = false;
+		}
+		return ok;
+#else
+		std::ofstream outFile(fileName, std::ios::binary);
+		if (outFile) {
+			for (uint64_t i = 0; i < stream.size(); ++i) {
+				outFile.write(stream[i].buf(), stream[i].buf_size());
+			}
+
+			outFile.close();
+		}
+		if (!outFile) {
+			log << warn << "write fail " << fileName << "\n";
+			return false;
+		}
+		return true;
+#endif
+	}
+
+	bool LoadData2::write_parallel(Arena* memory_pool, const std::string& fileName, _Value& j, uint64_t thr_num, bool pretty, OutputSink* sink) {
+		TraceScope scope("write_parallel");
 
 		if (!j.is_structured()) {
-			write(fileName, j, pretty, false);
-			return;
+			return write_serial(fileName, sink, j, pretty);
 		}
 
 		if (thr_num <= 0) {
@@ -2611,8 +4223,7 @@ namespace claujson {
 		}
 
 		if (thr_num == 1) {
-			write(fileName, j, pretty, false);
-			return;
+			return write_serial(fileName, sink, j, pretty);
 		}
 
 		//my_vector<claujson::StructuredPtr> temp(thr_num, nullptr); //
@@ -2628,6 +4239,14 @@ namespace claujson {
 		my_vector<claujson::StructuredPtr> pos(thr_num);
 
 		my_vector<claujson::StrStream> stream(thr_num);
+		my_vector<uint64_t> capacity(thr_num);
+		{
+			// parts are about same size.
+			const uint64_t estimate = EstimateSize(j, str_separators[pretty ? 1 : 0]) / thr_num;
+			for (uint64_t i = 0; i < thr_num; ++i) {
+				capacity[i] = presize(stream[i], estimate);
+			}
+		}
 
 		//my_vector<std::thread> thr(thr_num);
 		my_vector<std::future<void>> thr_result(thr_num);
@@ -2643,13 +4262,7 @@ namespace claujson {
 				}
 
 				auto a = std::chrono::steady_clock::now();
-				uint64_t len = 0;
-				if (j.is_array()) {
-					len = Size(j.as_array());
-				}
-				else if (j.is_object()) {
-					len = Size(j.as_object());
-				}
+				uint64_t len = NodeCount(j);
 				auto b = std::chrono::steady_clock::now();
 				auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
 				log << info << "size is " << dur.count() << "ms\n";
@@ -2726,10 +4339,10 @@ namespace claujson {
 						}
 
 						if (i == 0) {
-							thr_result[0] = pool->enqueue(write_, std::ref(stream[0]), std::cref(j), temp_parent[0], pretty, (false));
+							thr_result[0] = pool->enqueue(write_, std::ref(stream[0]), std::cref(j), temp_parent[0], pretty, (false), 0);
 						}
 						else {
-							thr_result[i] = pool->enqueue(write_, std::ref(stream[i]), std::cref(result[i - 1].get_value_list(0)), temp_parent[i], pretty, (hint[i - 1]));
+							thr_result[i] = pool->enqueue(write_, std::ref(stream[i]), std::cref(result[i - 1].get_value_list(0)), temp_parent[i], pretty, (hint[i - 1]), i);
 						}
 					}
 
@@ -2761,15 +4374,17 @@ namespace claujson {
 					}
 
 					thr_result[i] = pool->enqueue(write_, std::ref(stream[i]), 
-						std::cref(result[i - 1].get_value_list(0)), temp_parent[i], pretty, (hint[i - 1]));
+						std::cref(result[i - 1].get_value_list(0)), temp_parent[i], pretty, (hint[i - 1]), i);
 				}
 
 				break;
 			}
 		}
 		if (quit) {
-			write(fileName, j, pretty, false);
-			return;
+			if (stats) {
+				*stats = WriteStats();
+			}
+			return write_serial(fileName, sink, j, pretty);
 		}
 
 		auto b = std::chrono::steady_clock::now();
@@ -2795,6 +4410,7 @@ namespace claujson {
 
 		for (uint64_t i = 0; i < thr_num; ++i) {
 			thr_result[i].get();
+			add_write_stats(stream[i], capacity[i]);
 		}
 
 		b = std::chrono::steady_clock::now();
@@ -2821,17 +4437,11 @@ namespace claujson {
 			}
 		}
 		a = std::chrono::steady_clock::now();
-		std::ofstream outFile(fileName, std::ios::binary);
-		if (outFile) {
-			for (uint64_t i = 0; i < stream.size(); ++i) {
-				outFile.write(stream[i].buf(), stream[i].buf_size());
-			}
-
-			outFile.close();
-		}
+		const bool ok = write_out(fileName, sink, stream);
 		b = std::chrono::steady_clock::now();
 		dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
 		log << info << "write to file " << dur.count() << "ms\n";
+		return ok;
 	}
 
 	class JsonView {
@@ -3018,10 +4628,10 @@ namespace claujson {
 		}
 	}
 
-	void LoadData2::write_parallel2(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty) {
+	bool LoadData2::write_parallel2(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty, OutputSink* sink) {
+		TraceScope scope("write_parallel2");
 		if (!j.is_structured()) {
-			write(fileName, j, pretty, false);
-			return;
+			return write_serial(fileName, sink, j, pretty);
 		}
 
 		if (thr_num <= 0) {
@@ -3033,8 +4643,7 @@ namespace claujson {
 		}
 
 		if (thr_num == 1) {
-			write(fileName, j, pretty, false);
-			return;
+			return write_serial(fileName, sink, j, pretty);
 		}
 
 		auto a = std::chrono::steady_clock::now();
@@ -3090,47 +4699,669 @@ namespace claujson {
 			thr_num = start.size() - 1;
 		}
 
-		my_vector<std::future<void>> thr_result(thr_num);
+		my_vector<uint64_t> capacity(thr_num);
+		{
+			// views are split evenly.
+			const uint64_t estimate = EstimateSize(j, view_separators[pretty ? 1 : 0]) / thr_num;
+			for (uint64_t i = 0; i < thr_num; ++i) {
+				capacity[i] = presize(stream[i], estimate);
+			}
+		}
+
 		if (pretty) {
-			my_vector<std::thread> thread_print(thr_num);
+			pool->parallel_for(0, thr_num, [&](size_t i) {  // end[i] ?
+				TraceScope scope("print_pretty", i);
+				print_pretty(view_arr + start[i], view_arr + last[i], stream[i]);
+			});
+		}
+		else {
+			pool->parallel_for(0, thr_num, [&](size_t i) {
+				TraceScope scope("print", i);
+				print(view_arr + start[i], view_arr + last[i], stream[i]);
+			});
+		}
+		b = std::chrono::steady_clock::now();
+		dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		log << info << "print " << dur.count() << "\n";
+
+		for (uint64_t i = 0; i < thr_num; ++i) {
+			add_write_stats(stream[i], capacity[i]);
+		}
+
+		a = std::chrono::steady_clock::now();
+		const bool ok = write_out(fileName, sink, stream);
+		b = std::chrono::steady_clock::now();
+		dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		log << info << "write to file " << dur.count() << "ms\n";
+	
+		free(view_arr);
+		return ok;
+	}
+
+	// no tree change, no flatten array. split by child ranges of containers with about total / want nodes,
+	//  go down into structured children bigger than that. uses cached node counts. (Array, Object::get_node_count)
+	void LoadData2::SplitWriteRange(const _Value& data, uint64_t want, bool pretty, std::vector<WriteRange>& out) {
+		StructuredPtr ut(data);
+		const uint64_t len = ut.get_data_size();
+
+		if (want <= 1 || len == 0) {
+			out.push_back(WriteRange{ &data, 0, len, {} });
+			return;
+		}
+
+		const uint64_t total = NodeCount(data);
+		const uint64_t target = std::max<uint64_t>(1, total / want);
+
+		// children are (almost) primitives.
+		if (len >= want && total - 1 - len < target) {
+			for (uint64_t k = 0; k < want; ++k) {
+				out.push_back(WriteRange{ &data, len * k / want, len * (k + 1) / want, {} });
+			}
+			return;
+		}
+
+		uint64_t begin = 0;
+		uint64_t sum = 0;
 
-			for (uint64_t i = 0; i < thread_print.size(); ++i) {  // end[i] ?
-				thr_result[i] = pool->enqueue(print_pretty, view_arr + start[i], view_arr + last[i], std::ref(stream[i]));
+		for (uint64_t i = 0; i < len; ++i) {
+			const _Value& x = ut.get_value_list(i);
+			const uint64_t count = NodeCount(x);
+
+			if (count <= target || StructuredPtr(x).get_data_size() == 0) {
+				sum += count;
+				if (sum >= target) {
+					out.push_back(WriteRange{ &data, begin, i + 1, {} });
+					begin = i + 1;
+					sum = 0;
+				}
+				continue;
+			}
+
+			if (begin < i) {
+				out.push_back(WriteRange{ &data, begin, i, {} });
+			}
+			begin = i + 1;
+			sum = 0;
+
+			StrStream stream;
+
+			if (i > 0) {
+				stream.add_2(str_comma[pretty ? 1 : 0]);
+			}
+			if (ut.is_object()) {
+				auto& key = ut.get_key_list(i);
+				if (key.is_str()) {
+					write_string(stream, key.str_val());
+					stream.add_2(str_colon[pretty ? 1 : 0]);
+				}
 			}
+			stream.add_2(x.is_array() ? str_open_array[pretty ? 1 : 0] : str_open_object[pretty ? 1 : 0]);
+
+			out.push_back(WriteRange{ nullptr, 0, 0, std::string(stream.buf(), stream.buf_size()) });
+
+			SplitWriteRange(x, (count + target - 1) / target, pretty, out);
+
+			out.push_back(WriteRange{ nullptr, 0, 0, x.is_array() ? str_close_array[pretty ? 1 : 0] : str_close_object[pretty ? 1 : 0] });
+		}
+
+		if (begin < len) {
+			out.push_back(WriteRange{ &data, begin, len, {} });
+		}
+	}
 
-			for (uint64_t i = 0; i < thread_print.size(); ++i) {
-				thr_result[i].get();
+	// output bytes of string, with quotes and escapes.
+	static uint64_t string_size(const String& str) {
+		uint64_t size = str.size() + 2;
+		if (str.escape_info() == 1) {
+			return size;
+		}
+		const char* end = str.data() + str.size();
+		for (const char* p = find_escape(str.data(), end); p < end; p = find_escape(p + 1, end)) {
+			switch (*p) {
+			case '\\': case '\"': case '\n': case '\b': case '\f': case '\r': case '\t':
+				size += 1;
+				break;
+			default:
+				size += 5; // \uDDDD
 			}
 		}
+		return size;
+	}
+
+	// output bytes of primitive.
+	static uint64_t primitive_size(const _Value& x) {
+		if (x.is_str()) {
+			return string_size(x.str_val());
+		}
+		else if (x.type() == _ValueType::BOOL) {
+			return x.bool_val() ? 4 : 5;
+		}
+		else if (x.is_lazy_number()) {
+			return x.get_number_text().size();
+		}
+		else if (x.type() == _ValueType::FLOAT) {
+			return fmt::formatted_size("{}", x.float_val());
+		}
+		else if (x.type() == _ValueType::INT) {
+			return fmt::formatted_size("{}", x.int_val());
+		}
+		else if (x.type() == _ValueType::UINT) {
+			return fmt::formatted_size("{}", x.uint_val());
+		}
+		else if (x.type() == _ValueType::NULL_) {
+			return 4;
+		}
+		return 0;
+	}
+
+	// visit at most `budget` nodes of x, add output bytes of them. (with comma, key)
+	static void SampleSize(const _Value& x, const _Value* key, const Separators& sep, uint64_t& budget, uint64_t& nodes, uint64_t& bytes) {
+		--budget;
+		++nodes;
+
+		bytes += sep.comma;
+		if (key && key->is_str()) {
+			bytes += string_size(key->str_val()) + sep.colon;
+		}
+
+		if (!x.is_structured()) {
+			bytes += primitive_size(x);
+			return;
+		}
+
+		bytes += sep.open + sep.close;
+
+		StructuredPtr ut(x);
+		const uint64_t len = ut.get_data_size();
+		if (len > 0) {
+			bytes -= sep.comma; // no comma after last child.
+		}
+		for (uint64_t i = 0; i < len && budget > 0; ++i) {
+			SampleSize(ut.get_value_list(i), ut.is_object() ? &ut.get_key_list(i) : nullptr, sep, budget, nodes, bytes);
+		}
+	}
+
+	// (bytes per node of 64 or more sampled children) * (nodes in range), visit about `budget` nodes.
+	//  small child -> exact size,
+	//  big child -> estimate of its children, or (node count) * (bytes per node of a part of it).
+	uint64_t LoadData2::EstimateSize(const WriteRange& range, const Separators& sep, uint64_t budget) {
+		if (range.data == nullptr) {
+			return range.text.size();
+		}
+		if (range.begin >= range.end) {
+			return 0;
+		}
+
+		StructuredPtr ut(*range.data);
+		const uint64_t n = range.end - range.begin;
+
+		// bytes per node is more stable than bytes per child.
+		uint64_t total = 0;
+		if (n == ut.get_data_size()) {
+			total = NodeCount(*range.data) - 1;
+		}
 		else {
-			my_vector<std::thread> thread_print(thr_num);
-			
-			for (uint64_t i = 0; i < thread_print.size(); ++i) {
-				thr_result[i] = pool->enqueue(print, view_arr + start[i], view_arr + last[i], std::ref(stream[i]));
+			for (uint64_t i = range.begin; i < range.end; ++i) {
+				total += NodeCount(ut.get_value_list(i));
 			}
-			
-			for (uint64_t i = 0; i < thread_print.size(); ++i) {
-				thr_result[i].get();
+		}
+
+		// about 2 * (avg nodes per child) for each sample : most sampled children are visited whole, not by a prefix.
+		const uint64_t samples = std::max<uint64_t>(64, budget / std::max<uint64_t>(1, 2 * total / n));
+		const uint64_t step = n > samples ? n / samples : 1;
+		const uint64_t share = std::max<uint64_t>(1, budget / ((n + step - 1) / step));
+
+		uint64_t sampled = 0; // nodes of sampled children.
+		double sum = 0;
+
+		for (uint64_t i = range.begin; i < range.end; i += step) {
+			const _Value& x = ut.get_value_list(i);
+			const _Value* key = ut.is_object() ? &ut.get_key_list(i) : nullptr;
+			const uint64_t count = NodeCount(x);
+
+			sampled += count;
+
+			if (count <= share || StructuredPtr(x).get_data_size() == 0) {
+				uint64_t left = count;
+				uint64_t nodes = 0;
+				uint64_t bytes = 0;
+				SampleSize(x, key, sep, left, nodes, bytes);
+				sum += bytes;
+			}
+			else if (share >= 64) {
+				uint64_t left = 1;
+				uint64_t nodes = 0;
+				uint64_t bytes = 0;
+				SampleSize(x, key, sep, left, nodes, bytes); // comma, key, open, close.
+				sum += bytes + EstimateSize(WriteRange{ &x, 0, StructuredPtr(x).get_data_size(), {} }, sep, share);
+			}
+			else {
+				uint64_t left = std::max<uint64_t>(share, 16); // not a few nodes of containers only.
+				uint64_t nodes = 0;
+				uint64_t bytes = 0;
+				SampleSize(x, key, sep, left, nodes, bytes);
+				sum += (double)count * bytes / nodes;
 			}
 		}
-		b = std::chrono::steady_clock::now();
-		dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
-		log << info << "print " << dur.count() << "\n";
+
+		return (uint64_t)(sum / sampled * total);
+	}
+
+	uint64_t LoadData2::EstimateSize(const _Value& data, const Separators& sep) {
+		if (!data.is_structured()) {
+			return primitive_size(data);
+		}
+		return sep.open + sep.close
+			+ EstimateSize(WriteRange{ &data, 0, StructuredPtr(data).get_data_size(), {} }, sep);
+	}
+
+	uint64_t LoadData2::presize(StrStream& stream, uint64_t estimate) {
+		stream.reserve(estimate + estimate / 8);
+		if (stats) {
+			stats->estimated_size += estimate;
+			stats->buffer_count++;
+		}
+		return stream.capacity();
+	}
+
+	void LoadData2::add_write_stats(const StrStream& stream, uint64_t capacity) {
+		if (stats) {
+			stats->output_size += stream.buf_size();
+			if (stream.capacity() != capacity) {
+				stats->buffer_grow_count++;
+			}
+		}
+	}
+
+	void LoadData2::write_range(StrStream& stream, const WriteRange& range, bool pretty) {
+		if (range.data == nullptr) {
+			stream.add_1(range.text.data(), range.text.size());
+			return;
+		}
+
+		StructuredPtr ut(*range.data);
+		const bool is_obj = ut.is_object();
+
+		for (uint64_t i = range.begin; i < range.end; ++i) {
+			if (i > 0) {
+				stream.add_2(str_comma[pretty ? 1 : 0]);
+			}
+
+			if (is_obj) {
+				auto& key = ut.get_key_list(i);
+				if (key.is_str()) {
+					write_string(stream, key.str_val());
+					stream.add_2(str_colon[pretty ? 1 : 0]);
+				}
+			}
+
+			const _Value& x = ut.get_value_list(i);
+
+			if (x.is_array()) {
+				stream.add_2(str_open_array[pretty ? 1 : 0]);
+				_write(stream, x, 1, pretty);
+				stream.add_2(str_close_array[pretty ? 1 : 0]);
+			}
+			else if (x.is_object()) {
+				stream.add_2(str_open_object[pretty ? 1 : 0]);
+				_write(stream, x, 1, pretty);
+				stream.add_2(str_close_object[pretty ? 1 : 0]);
+			}
+			else {
+				write_primitive(stream, x);
+			}
+		}
+	}
+
+	// j is not changed, (cf. write_parallel - Divide and Merge2).
+	bool LoadData2::write_parallel3(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty, OutputSink* sink) {
+		TraceScope scope("write_parallel3");
+		if (!j.is_structured()) {
+			return write_serial(fileName, sink, j, pretty);
+		}
+
+		if (thr_num <= 0) {
+			thr_num = std::max((int)std::thread::hardware_concurrency() - 2, 1);
+		}
+		if (thr_num <= 0) {
+			thr_num = 1;
+		}
+
+		if (control && control->is_cancelled()) {
+			log << info << "cancelled\n";
+			return false;
+		}
+
+		if (thr_num == 1) {
+			return write_serial(fileName, sink, j, pretty);
+		}
+
+		auto a = std::chrono::steady_clock::now();
+		uint64_t phase_start = now_ns();
+
+		std::vector<WriteRange> range;
+
+		range.push_back(WriteRange{ nullptr, 0, 0, j.is_array() ? str_open_array[pretty ? 1 : 0] : str_open_object[pretty ? 1 : 0] });
+		SplitWriteRange(j, thr_num * 4, pretty, range); // more ranges than threads, for balance.
+		range.push_back(WriteRange{ nullptr, 0, 0, j.is_array() ? str_close_array[pretty ? 1 : 0] : str_close_object[pretty ? 1 : 0] });
+
+		auto b = std::chrono::steady_clock::now();
+		auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		log << info << "split " << range.size() << " " << dur.count() << "ms\n";
+		phase_start = EndPhase("split", phase_start, stats ? &stats->split_ns : nullptr);
 
 		a = std::chrono::steady_clock::now();
-		std::ofstream outFile(fileName, std::ios::binary);
-		if (outFile) {
-			for (uint64_t i = 0; i < thr_num; ++i) {
-				outFile.write(stream[i].buf(), stream[i].buf_size());
+
+		my_vector<claujson::StrStream> stream(range.size());
+		my_vector<uint64_t> capacity(range.size());
+
+		for (uint64_t i = 0; i < range.size(); ++i) {
+			if (range[i].data) {
+				capacity[i] = presize(stream[i], EstimateSize(range[i], str_separators[pretty ? 1 : 0]));
+				if (control) {
+					control->total += capacity[i];
+				}
 			}
+		}
 
-			outFile.close();
+		phase_start = EndPhase("presize", phase_start, stats ? &stats->presize_ns : nullptr);
+		if (stats) {
+			stats->chunks.resize(range.size());
+		}
+
+		// cancel is checked before each range.
+		auto write_one = [&](size_t i) {
+			if (control && control->is_cancelled()) {
+				return;
+			}
+			TraceScope scope("write_range", i);
+			PerfScope perf_scope(stats && stats->perf_counters ? &stats->chunks[i].counters : nullptr);
+			const uint64_t chunk_start = stats ? now_ns() : 0;
+			write_range(stream[i], range[i], pretty);
+			if (control) {
+				control->done += stream[i].buf_size();
+			}
+			if (stats) {
+				WriteStats::Chunk& c = stats->chunks[i];
+				c.bytes = stream[i].buf_size();
+				c.ns = now_ns() - chunk_start;
+				c.worker = pool->worker_index();
+			}
+		};
+
+		if (pool->node_count() > 1) {
+			// range -> node of memory of its first child (built there), or by position.
+			my_vector<uint64_t> node(range.size());
+			for (uint64_t i = 0; i < range.size(); ++i) {
+				int64_t x = -1;
+				if (range[i].data && range[i].begin < range[i].end) {
+					const _Value& first = StructuredPtr(*range[i].data).get_value_list(range[i].begin);
+					x = memory_node(first.is_array() ? static_cast<const void*>(first.as_array())
+						: first.is_object() ? static_cast<const void*>(first.as_object()) : static_cast<const void*>(&first));
+				}
+				node[i] = x >= 0 ? x : i * pool->node_count() / range.size();
+			}
+			pool->parallel_for_node(0, range.size(), [&](size_t i) { return node[i]; }, write_one);
+		}
+		else {
+			pool->parallel_for_budget(0, range.size(), thr_num, write_one);
+		}
+		if (control && control->is_cancelled()) {
+			log << info << "cancelled\n";
+			return false;
+		}
+		for (uint64_t i = 0; i < range.size(); ++i) {
+			if (range[i].data) {
+				add_write_stats(stream[i], capacity[i]);
+			}
+		}
+
+		b = std::chrono::steady_clock::now();
+		dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		log << info << "write_range " << dur.count() << "ms\n";
+		phase_start = EndPhase("write", phase_start, stats ? &stats->write_ns : nullptr);
+		if (stats && stats->perf_counters) {
+			stats->write_counters = SumCounters(stats->chunks);
+		}
+		if (stats) {
+			SetUtilization(stats, stats->chunks, stats->write_ns);
 		}
+
+		a = std::chrono::steady_clock::now();
+		const bool ok = write_out(fileName, sink, stream);
+		EndPhase("output", phase_start, stats ? &stats->output_ns : nullptr);
 		b = std::chrono::steady_clock::now();
 		dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
 		log << info << "write to file " << dur.count() << "ms\n";
-	
-		free(view_arr);
+		return ok;
+	}
+
+	// same as _write, but hands full buffer to queue after each element.
+	void LoadData2::_write_stream(WriteQueue::Sink& sink, const _Value& data, bool pretty) {
+		StructuredPtr ut(data);
+		const bool is_obj = ut.is_object();
+		const uint64_t len = ut.get_data_size();
+
+		for (uint64_t i = 0; i < len; ++i) {
+			StrStream& stream = sink.stream();
+
+			if (i > 0) {
+				stream.add_2(str_comma[pretty ? 1 : 0]);
+			}
+
+			if (is_obj) {
+				auto& key = ut.get_key_list(i);
+				if (key.is_str()) {
+					write_string(stream, key.str_val());
+					stream.add_2(str_colon[pretty ? 1 : 0]);
+				}
+			}
+
+			const _Value& x = ut.get_value_list(i);
+
+			if (x.is_array()) {
+				stream.add_2(str_open_array[pretty ? 1 : 0]);
+				_write_stream(sink, x, pretty);
+				sink.stream().add_2(str_close_array[pretty ? 1 : 0]);
+			}
+			else if (x.is_object()) {
+				stream.add_2(str_open_object[pretty ? 1 : 0]);
+				_write_stream(sink, x, pretty);
+				sink.stream().add_2(str_close_object[pretty ? 1 : 0]);
+			}
+			else {
+				write_primitive(stream, x);
+			}
+
+			sink.check();
+		}
+	}
+
+	void LoadData2::write_range_stream(WriteQueue* queue, uint64_t idx, const WriteRange& range, bool pretty) {
+		WriteQueue::Sink sink(queue, idx);
+
+		if (range.data == nullptr) {
+			sink.stream().add_1(range.text.data(), range.text.size());
+			sink.finish();
+			return;
+		}
+
+		StructuredPtr ut(*range.data);
+		const bool is_obj = ut.is_object();
+
+		for (uint64_t i = range.begin; i < range.end; ++i) {
+			StrStream& stream = sink.stream();
+
+			if (i > 0) {
+				stream.add_2(str_comma[pretty ? 1 : 0]);
+			}
+
+			if (is_obj) {
+				auto& key = ut.get_key_list(i);
+				if (key.is_str()) {
+					write_string(stream, key.str_val());
+					stream.add_2(str_colon[pretty ? 1 : 0]);
+				}
+			}
+
+			const _Value& x = ut.get_value_list(i);
+
+			if (x.is_array()) {
+				stream.add_2(str_open_array[pretty ? 1 : 0]);
+				_write_stream(sink, x, pretty);
+				sink.stream().add_2(str_close_array[pretty ? 1 : 0]);
+			}
+			else if (x.is_object()) {
+				stream.add_2(str_open_object[pretty ? 1 : 0]);
+				_write_stream(sink, x, pretty);
+				sink.stream().add_2(str_close_object[pretty ? 1 : 0]);
+			}
+			else {
+				write_primitive(stream, x);
+			}
+
+			sink.check();
+		}
+
+		sink.finish();
+	}
+
+	// output memory is at most (2 * threads + 3) buffers of about buf_size, not whole output size.
+	//  (2 * threads in use + ready and filling buffers of the range being flushed)
+	bool LoadData2::write_parallel_stream(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty, uint64_t buf_size, OutputSink* sink) {
+		TraceScope scope("write_parallel_stream");
+		if (!j.is_structured()) {
+			return write_serial(fileName, sink, j, pretty);
+		}
+
+		if (thr_num <= 0) {
+			thr_num = std::max((int)std::thread::hardware_concurrency() - 2, 1);
+		}
+		if (thr_num <= 0) {
+			thr_num = 1;
+		}
+		if (buf_size == 0) {
+			buf_size = 1 << 22;
+		}
+
+		auto a = std::chrono::steady_clock::now();
+
+		std::vector<WriteRange> range;
+
+		range.push_back(WriteRange{ nullptr, 0, 0, j.is_array() ? str_open_array[pretty ? 1 : 0] : str_open_object[pretty ? 1 : 0] });
+		SplitWriteRange(j, thr_num * 4, pretty, range);
+		range.push_back(WriteRange{ nullptr, 0, 0, j.is_array() ? str_close_array[pretty ? 1 : 0] : str_close_object[pretty ? 1 : 0] });
+
+		WriteQueue queue(range.size(), buf_size, 2, 2 * thr_num);
+
+		auto run = [&](uint64_t i) {
+			TraceScope scope("write_range_stream", i);
+			write_range_stream(&queue, i, range[i], pretty);
+		};
+
+		std::ofstream outFile;
+		bool ok = true;
+
+		if (!sink) {
+			outFile.open(fileName, std::ios::binary);
+			ok = static_cast<bool>(outFile);
+		}
+		else {
+			const uint64_t estimate = EstimateSize(j, str_separators[pretty ? 1 : 0]);
+			sink->reserve(estimate + estimate / 8);
+		}
+
+		// item 0 flushes, it is run on the caller first. others are lanes taking ranges in order.
+		//  flush runs the ranges no lane took yet, so this does not wait for lanes not started. (ex. called from a pool worker)
+		pool->parallel_for(0, thr_num + 1, [&](size_t x) {
+			if (x > 0) {
+				for (uint64_t i = queue.take(); i < range.size(); i = queue.take()) {
+					run(i);
+				}
+				return;
+			}
+			queue.flush([&](const char* buf, uint64_t len) {
+				if (!ok) {
+					return;
+				}
+				if (sink) {
+					ok = sink->write(buf, len);
+				}
+				else {
+					outFile.write(buf, len);
+				}
+			}, run);
+		});
+
+		if (outFile.is_open()) {
+			outFile.close();
+			ok = ok && static_cast<bool>(outFile);
+		}
+		if (!ok) {
+			log << warn << "write fail " << (sink ? std::string("to sink") : fileName) << "\n";
+		}
+
+		auto b = std::chrono::steady_clock::now();
+		auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		log << info << "write_parallel_stream " << queue.buffer_count() << " buffers " << dur.count() << "ms\n";
+		return ok;
+	}
+
+	bool LoadData2::write(OutputSink& sink, const _Value& global, bool pretty) {
+		if (!global.is_structured()) {
+			StrStream stream;
+			write_primitive(stream, global);
+			if (!sink.write(stream.buf(), stream.buf_size())) {
+				log << warn << "write to sink fail\n";
+				return false;
+			}
+			return true;
+		}
+
+		const uint64_t estimate = EstimateSize(global, str_separators[pretty ? 1 : 0]);
+		sink.reserve(estimate + estimate / 8);
+
+		WriteQueue queue(1, 1 << 16, 1, 1, &sink);
+
+		write_range_stream(&queue, 0, WriteRange{ nullptr, 0, 0, global.is_array() ? str_open_array[pretty ? 1 : 0] : str_open_object[pretty ? 1 : 0] }, pretty);
+		write_range_stream(&queue, 0, WriteRange{ &global, 0, StructuredPtr(global).get_data_size(), {} }, pretty);
+		write_range_stream(&queue, 0, WriteRange{ nullptr, 0, 0, global.is_array() ? str_close_array[pretty ? 1 : 0] : str_close_object[pretty ? 1 : 0] }, pretty);
+
+		if (queue.is_fail()) {
+			log << warn << "write to sink fail\n";
+			return false;
+		}
+		return true;
+	}
+
+	bool LoadData2::write_serial(const std::string& fileName, OutputSink* sink, const _Value& j, bool pretty) {
+		TraceScope scope("write_serial");
+		if (sink) {
+			return write(*sink, j, pretty);
+		}
+		else {
+			return write(fileName, j, pretty, false);
+		}
+	}
+
+	bool LoadData2::write_out(const std::string& fileName, OutputSink* sink, const my_vector<StrStream>& stream) {
+		if (!sink) {
+			return write_file(fileName, stream);
+		}
+
+		uint64_t total = 0;
+		for (uint64_t i = 0; i < stream.size(); ++i) {
+			total += stream[i].buf_size();
+		}
+		sink->reserve(total);
+
+		for (uint64_t i = 0; i < stream.size(); ++i) {
+			if (stream[i].buf_size() > 0 && !sink->write(stream[i].buf(), stream[i].buf_size())) {
+				log << warn << "write to sink fail\n";
+				return false;
+			}
+		}
+		return true;
 	}
 
 	std::string LoadData2::write_to_str2(const _Value& j, bool pretty) {
@@ -3143,35 +5374,174 @@ namespace claujson {
 
 		claujson::StrStream stream;
 
-		a = std::chrono::steady_clock::now();
-		uint64_t size = Size2(j);
-		b = std::chrono::steady_clock::now();
-		auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
-		log << info << "Size2 " << dur.count() << "\n";
+		a = std::chrono::steady_clock::now();
+		uint64_t size = Size2(j);
+		b = std::chrono::steady_clock::now();
+		auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		log << info << "Size2 " << dur.count() << "\n";
+
+		a = std::chrono::steady_clock::now();
+		JsonView* view_arr = (JsonView*)calloc(size + 1, sizeof(JsonView));
+		JsonView* view_end = run(view_arr, &j);
+		b = std::chrono::steady_clock::now();
+		dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		log << info << "run " << dur.count() << "\n";
+
+		size = view_end - view_arr;
+
+		const uint64_t capacity = presize(stream, EstimateSize(j, view_separators[pretty ? 1 : 0]));
+
+		a = std::chrono::steady_clock::now();
+		if (pretty) {
+			print_pretty(view_arr, view_arr + size, stream);
+		}
+		else {
+			print(view_arr, view_arr + size, stream);
+		}
+		b = std::chrono::steady_clock::now();
+		dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		log << info << "print " << dur.count() << "\n";
+
+		free(view_arr);
+
+		add_write_stats(stream, capacity);
+
+		return std::string(stream.buf(), stream.buf_size());
+	}
+
+	bool LoadData2::reformat_chunk(StrStream& stream, const char* buf, uint64_t buf_len,
+		_simdjson::internal::dom_parser_implementation* imple, uint64_t start, uint64_t last, bool pretty,
+		int64_t* depth, int64_t* min_depth) {
+		const uint64_t n = imple->n_structural_indexes;
+		int64_t now = 0;
+		int64_t min = std::numeric_limits<int64_t>::max();
+		std::vector<uint8_t> temp; // for strings.
+
+		for (uint64_t i = start; i < last; ++i) {
+			const uint64_t pos = imple->structural_indexes[i];
+			const char ch = buf[pos];
+
+			switch (ch) {
+			case '{':
+			case '}':
+			case '[':
+			case ']':
+			case ',':
+			case ':':
+				if (!pretty) {
+					stream.add_char(ch);
+				}
+				else if (ch == '{') {
+					stream.add_2(str_open_object[1]);
+				}
+				else if (ch == '}') {
+					stream.add_2(str_close_object[1]);
+				}
+				else if (ch == '[') {
+					stream.add_2(str_open_array[1]);
+				}
+				else if (ch == ']') {
+					stream.add_2(str_close_array[1]);
+				}
+				else if (ch == ',') {
+					stream.add_2(str_comma[1]);
+				}
+				else {
+					stream.add_2(str_colon[1]);
+				}
+				break;
+			default:
+			{
+				// string, number, true, false, null. + white spaces until next structural char.
+				uint64_t end = i + 1 < n ? imple->structural_indexes[i + 1] : buf_len;
+				const uint8_t* text = reinterpret_cast<const uint8_t*>(buf + pos);
+
+				if (ch == 't' ? !_simdjson::is_valid_true_atom(text, end - pos)
+					: ch == 'f' ? !_simdjson::is_valid_false_atom(text, end - pos)
+					: ch == 'n' ? !_simdjson::is_valid_null_atom(text, end - pos)
+					: ch != '"' && !is_valid_number(buf + pos, end - pos, i == 0)) {
+					return false;
+				}
+				while (end > pos && (buf[end - 1] == ' ' || buf[end - 1] == '\n' || buf[end - 1] == '\r' || buf[end - 1] == '\t')) {
+					--end;
+				}
+				if (ch == '"' && !is_valid_string(buf + pos, end - pos, temp)) {
+					return false;
+				}
+				stream.add_1(buf + pos, end - pos);
+			}
+			break;
+			}
+
+			if (ch == '{' || ch == '[') {
+				++now;
+			}
+			else if (ch == '}' || ch == ']') {
+				--now;
+			}
+			if (i + 1 < n && now < min) {
+				min = now;
+			}
+		}
+
+		*depth = now;
+		*min_depth = min;
+		return true;
+	}
+
+	bool LoadData2::reformat(const char* buf, uint64_t buf_len, _simdjson::internal::dom_parser_implementation* imple,
+		uint64_t thr_num, bool pretty, const std::string& fileName, OutputSink* sink) {
+		TraceScope scope("reformat");
+		const uint64_t n = imple->n_structural_indexes;
+
+		if (thr_num <= 0) {
+			thr_num = 1;
+		}
+		if (thr_num > n) {
+			thr_num = n;
+		}
+
+		auto a = std::chrono::steady_clock::now();
+
+		my_vector<StrStream> stream(thr_num);
+		my_vector<int64_t> depth(thr_num);
+		my_vector<int64_t> min_depth(thr_num);
+		my_vector<uint8_t> valid(thr_num);
 
-		a = std::chrono::steady_clock::now();
-		JsonView* view_arr = (JsonView*)calloc(size + 1, sizeof(JsonView));
-		JsonView* view_end = run(view_arr, &j);
-		b = std::chrono::steady_clock::now();
-		dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
-		log << info << "run " << dur.count() << "\n";
+		pool->parallel_for(0, thr_num, [&](size_t i) {
+			const uint64_t start = n * i / thr_num;
+			const uint64_t last = n * (i + 1) / thr_num;
+			const uint64_t len = (last < n ? imple->structural_indexes[last] : buf_len) - imple->structural_indexes[start];
 
-		size = view_end - view_arr;
+			TraceScope scope("reformat_chunk", i);
+			// output <= input if minify, structural chars are at most 4 bytes if pretty.
+			stream[i].reserve(pretty ? len + 3 * (last - start) : len);
+			valid[i] = reformat_chunk(stream[i], buf, buf_len, imple, start, last, pretty, &depth[i], &min_depth[i]);
+		});
 
-		a = std::chrono::steady_clock::now();
-		if (pretty) {
-			print_pretty(view_arr, view_arr + size, stream);
+		// root value must end at last token.
+		int64_t now = 0;
+		for (uint64_t i = 0; i < thr_num; ++i) {
+			if (!valid[i]) {
+				log << warn << "not valid json, string, number or true/false/null\n";
+				return false;
+			}
+			if (min_depth[i] != std::numeric_limits<int64_t>::max() && now + min_depth[i] <= 0) {
+				log << warn << "not valid json, value after root value\n";
+				return false;
+			}
+			now += depth[i];
 		}
-		else {
-			print(view_arr, view_arr + size, stream);
+		if (now != 0) {
+			log << warn << "not valid json, root value is not closed\n";
+			return false;
 		}
-		b = std::chrono::steady_clock::now();
-		dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
-		log << info << "print " << dur.count() << "\n";
 
-		free(view_arr);
+		auto b = std::chrono::steady_clock::now();
+		auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		log << info << "reformat " << dur.count() << "ms\n";
 
-		return std::string(stream.buf(), stream.buf_size());
+		return write_out(fileName, sink, stream);
 	}
 
 	bool is_valid2(_simdjson::dom::parser_for_claujson& dom_parser, uint64_t start, uint64_t last,
@@ -4284,11 +6654,212 @@ namespace claujson {
 		return true;
 	}
 
+	// is_valid2 in chunks (split at ','), in parallel. same checks as parser::parse.
+	static bool is_valid_parallel(ThreadPool* pool, _simdjson::dom::parser_for_claujson& test_, uint64_t length, uint64_t thr_num) {
+		const auto& buf = test_.raw_buf();
+		auto* simdjson_imple_ = test_.raw_implementation().get();
+
+		uint64_t* count_vec = (uint64_t*)malloc(length * sizeof(uint64_t));
+		if (!count_vec) {
+			log << warn << "malloc fail in is_valid_parallel.";
+			return false;
+		}
+
+		std::set<uint64_t> _set;
+		for (uint64_t i = 1; i < thr_num; ++i) {
+			for (uint64_t j = length / thr_num * i; j < length; ++j) {
+				if (buf[simdjson_imple_->structural_indexes[j]] == ',') {
+					_set.insert(j);
+					break;
+				}
+			}
+		}
+		_set.insert(0);
+
+		if (_set.size() == 1) {
+			int start_state = 0;
+			int last_state = 0;
+			const bool valid = is_valid2(test_, 0, length - 1, &start_state, &last_state, nullptr, nullptr, count_vec);
+			free(count_vec);
+			return valid;
+		}
+
+		my_vector<uint64_t> start;
+		for (auto x : _set) { // order is important.
+			start.push_back(x);
+		}
+		start.push_back(length - 1);
+
+		const uint64_t n = _set.size();
+		my_vector<int> start_state(n);
+		my_vector<int> last_state(n);
+		my_vector<Vector<int8_t>> is_array(n), is_virtual_array(n);
+		my_vector<int> thr_result(n);
+
+		pool->parallel_for(0, n, [&](size_t i) {
+			TraceScope scope("is_valid2", i);
+			start_state[i] = -1;
+			last_state[i] = -1;
+			thr_result[i] = is_valid2(test_, start[i], start[i + 1], &start_state[i], &last_state[i],
+				&is_array[i], &is_virtual_array[i], count_vec);
+		});
+
+		bool valid = true;
+		for (uint64_t i = 0; i < n; ++i) {
+			if (!thr_result[i]) {
+				valid = false;
+			}
+		}
+		free(count_vec);
+
+		if (!valid) {
+			return false;
+		}
+
+		for (uint64_t i = 0; i + 1 < n; ++i) {
+			if (start_state[i + 1] != last_state[i]) {
+				return false;
+			}
+		}
+
+		if (is_virtual_array[0].empty() == false) { // first block has no virtual array or virtual object.
+			return false;
+		}
+
+		for (uint64_t i = 1; i < n; ++i) {
+			if (is_array[0].size() < is_virtual_array[i].size()) {
+				return false;
+			}
+			for (uint64_t j = 0; j < is_virtual_array[i].size(); ++j) {
+				if (is_array[0].back() != is_virtual_array[i][j]) {
+					return false;
+				}
+				is_array[0].pop_back();
+			}
+			for (uint64_t x = 0; x < is_array[i].size(); ++x) {
+				is_array[0].push_back(is_array[i][x]);
+			}
+		}
+
+		return is_array[0].empty();
+	}
+
+	static std::mutex scheduler_mutex;
+	static SchedulerOption scheduler_option;
+	static std::weak_ptr<ThreadPool> scheduler_pool;
+	static std::atomic<int64_t> scheduler_jobs{ 0 }; // running calls.
+
+	bool set_scheduler_option(const SchedulerOption& option) {
+		std::unique_lock<std::mutex> lock(scheduler_mutex);
+		if (!scheduler_pool.expired()) {
+			return false;
+		}
+		scheduler_option = option;
+		return true;
+	}
+
+	SchedulerOption get_scheduler_option() {
+		std::unique_lock<std::mutex> lock(scheduler_mutex);
+		return scheduler_option;
+	}
+
 	[[nodiscard]]
-	std::unique_ptr<ThreadPool> pool_init(int thr_num);
+	static std::shared_ptr<ThreadPool> shared_pool() {
+		std::unique_lock<std::mutex> lock(scheduler_mutex);
+
+		std::shared_ptr<ThreadPool> pool = scheduler_pool.lock();
+		if (!pool) {
+			int thr_num = scheduler_option.thr_num;
+			if (thr_num <= 0) {
+				thr_num = std::max((int)std::thread::hardware_concurrency() - 2, 1);
+			}
+
+			std::vector<int> cpus, nodes; // of workers.
+			numa_node_index.clear();
+			if (scheduler_option.numa) {
+				std::vector<int> node_id;
+				std::vector<std::vector<int>> node_cpus;
+				numa_topology(node_id, node_cpus);
+
+				// worker i -> i-th of all cpus spread evenly, so nodes get workers by their cpu count.
+				std::vector<std::pair<int, int>> all; // cpu, node index
+				for (uint64_t i = 0; i < node_cpus.size(); ++i) {
+					for (int cpu : node_cpus[i]) {
+						all.push_back({ cpu, static_cast<int>(i) });
+					}
+				}
+				if (!all.empty()) {
+					for (int i = 0; i < thr_num; ++i) {
+						const auto& x = all[static_cast<uint64_t>(i) * all.size() / thr_num];
+						cpus.push_back(x.first);
+						nodes.push_back(x.second);
+					}
+					numa_node_index.assign(node_id.back() + 1, -1);
+					for (uint64_t i = 0; i < node_id.size(); ++i) {
+						numa_node_index[node_id[i]] = static_cast<int>(i);
+					}
+				}
+				else {
+					log << warn << "numa topology is not found\n";
+				}
+			}
+
+			pool = std::make_shared<ThreadPool>(thr_num, cpus, nodes);
+			scheduler_pool = pool;
+		}
+		return pool;
+	}
+
+	// one public parse or write call on the shared pool, budget : threads it uses at the same time. (caller included)
+	//  budget is fixed when the call starts, by the calls running then. scheduler_option is not changed while pool is alive.
+	//  counted = false : call inside another job, (ex. documents of parse_batch) thr_num is budget of that job.
+	class Job {
+	public:
+		uint64_t budget;
+		const bool counted;
+
+		Job(const ThreadPool* pool, uint64_t thr_num, uint64_t max_thr_num, bool counted = true) : counted(counted) {
+			if (!counted) {
+				budget = thr_num > 0 ? thr_num : 1;
+				return;
+			}
+			const int64_t jobs = scheduler_jobs.fetch_add(1) + 1;
+
+			budget = thr_num > 0 ? thr_num : pool->size();
+			if (max_thr_num > 0) {
+				budget = std::min(budget, max_thr_num);
+			}
+			if (scheduler_option.max_budget > 0) {
+				budget = std::min<uint64_t>(budget, scheduler_option.max_budget);
+			}
+			if (scheduler_option.fair) {
+				budget = std::min<uint64_t>(budget, 1 + pool->size() / jobs);
+			}
+			if (budget == 0) {
+				budget = 1;
+			}
+		}
+		~Job() {
+			if (counted) {
+				scheduler_jobs.fetch_sub(1);
+			}
+		}
+
+		Job(const Job&) = delete;
+		Job& operator=(const Job&) = delete;
+	};
 
-	parser::parser(int thr_num) {
-		pool = pool_init(thr_num);
+	// not more threads than chunks of chunk_min_tokens tokens, or of chunk_min_bytes bytes. (long strings : few tokens, many bytes.)
+	static uint64_t ChunkThreads(const ParseOption& option, uint64_t thr_num, uint64_t tokens, uint64_t bytes) {
+		if (option.chunk_min_tokens == 0 || option.chunk_min_bytes == 0) {
+			return thr_num;
+		}
+		const uint64_t chunks = std::max<uint64_t>(tokens / option.chunk_min_tokens, bytes / option.chunk_min_bytes);
+		return std::min<uint64_t>(thr_num, std::max<uint64_t>(chunks, 1));
+	}
+
+	parser::parser(int thr_num) : max_thr_num(thr_num > 0 ? thr_num : 0) {
+		pool = shared_pool();
 	}
 
 	std::pair<bool, uint64_t> parser::parse(const std::string& fileName, Document& d, uint64_t thr_num)
@@ -4300,7 +6871,16 @@ namespace claujson {
 			thr_num = 1;
 		}
 
+		Job job(pool.get(), thr_num, max_thr_num, !in_job);
+		thr_num = job.budget;
+
 		_Value& ut = d.Get();
+		dup_key_path.clear();
+
+		ParseStats* st = option.stats ? &stats : nullptr;
+		StatsScope<ParseStats> scope(st, option.perf_counters);
+		const bool perf = st && st->perf_counters;
+		TraceScope trace_scope("parse");
 
 		uint64_t length = 0;
 
@@ -4311,6 +6891,8 @@ namespace claujson {
 
 			log << info << "simdjson-stage1 start\n";
 			// not static??
+			const uint64_t stage1_start = now_ns();
+			PerfScope stage1_perf(perf ? &st->stage1_counters : nullptr);
 			auto x = test_.load(fileName);
 
 			if (x.error() != _simdjson::error_code::SUCCESS) {
@@ -4326,6 +6908,33 @@ namespace claujson {
 			const auto buf_len = test_.raw_len();
 
 			auto* simdjson_imple_ = test_.raw_implementation().get();
+			EndPhase("stage1", stage1_start, st ? &st->stage1_ns : nullptr);
+			stage1_perf.end();
+
+			if (control) {
+				control->total = buf_len;
+				if (control->is_cancelled()) {
+					log << info << "cancelled\n";
+					return { false, 0 };
+				}
+			}
+
+			thr_num = ChunkThreads(option, thr_num, simdjson_imple_->n_structural_indexes, buf_len);
+			// one thread : no chunks.
+			if (thr_num == 1 && simdjson_imple_->n_structural_indexes > 0) {
+				LoadData2 p(pool.get());
+				p.control = control;
+				p.parse_stats = st;
+				p.chk_key_dup = option.chk_key_dup;
+				p.str_heap = option.str_heap;
+				p.lazy_number = option.lazy_number;
+
+				if (false == p.parse_small(ut, d.pool, buf, buf_len, simdjson_imple_)) {
+					dup_key_path = std::move(p.dup_key_path);
+					return { false, 0 };
+				}
+				return { true, simdjson_imple_->n_structural_indexes };
+			}
 
 			my_vector<int64_t> start(thr_num + 1);
 			//my_vector<int> key;
@@ -4357,6 +6966,8 @@ namespace claujson {
 			b = std::chrono::steady_clock::now();
 
 				std::set<uint64_t> _set;
+			const uint64_t partition_start = now_ns();
+			uint64_t validate_start = 0;
 			//if (!is_valid(test, length - 1)) {
 			//	return { false, 0 };
 			//}
@@ -4407,9 +7018,12 @@ namespace claujson {
 					for (uint64_t i = 0; i < _set.size(); ++i) {
 						last[i] = start[i + 1];
 					}
+					validate_start = EndPhase("partition", partition_start, st ? &st->partition_ns : nullptr);
+					if (st) {
+						st->validate_chunks.resize(_set.size());
+					}
 
 					my_vector<Vector<int8_t>> is_array(_set.size()), is_virtual_array(_set.size());
-					my_vector<std::future<bool>> thr_result(_set.size());
 					//int err = 0;
 
 					count_vec = (uint64_t*)malloc(length * sizeof(uint64_t));
@@ -4420,15 +7034,22 @@ namespace claujson {
 
 					if (thr_num > 1) {
 
-						for (uint64_t i = 0; i < _set.size(); ++i) {
-							thr_result[i] = pool->enqueue(is_valid2, std::ref(test_), start[i], last[i], &start_state[i], &last_state[i],
-								&is_array[i], &is_virtual_array[i], count_vec);
-						}
 						my_vector<int> result(_set.size());
 
-						for (uint64_t i = 0; i < _set.size(); ++i) {
-							result[i] = static_cast<int>(thr_result[i].get());
-						}
+						pool->parallel_for(0, _set.size(), [&](size_t i) {
+							TraceScope scope("is_valid2", i);
+							PerfScope perf_scope(perf ? &st->validate_chunks[i].counters : nullptr);
+							const uint64_t chunk_start = st ? now_ns() : 0;
+							result[i] = static_cast<int>(is_valid2(test_, start[i], last[i], &start_state[i], &last_state[i],
+								&is_array[i], &is_virtual_array[i], count_vec));
+							if (st) {
+								ParseStats::Chunk& c = st->validate_chunks[i];
+								c.tokens = last[i] - start[i];
+								c.bytes = simdjson_imple_->structural_indexes[last[i]] - simdjson_imple_->structural_indexes[start[i]];
+								c.ns = now_ns() - chunk_start;
+								c.worker = pool->worker_index();
+							}
+						});
 
 						for (uint64_t i = 0; i < result.size(); ++i) {
 							if (result[i] == false) {
@@ -4492,16 +7113,27 @@ namespace claujson {
 			dur = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - b);
 			log << info << dur.count() << "ms\n";
 
+			EndPhase("validate", validate_start, st ? &st->validate_ns : nullptr);
+			if (perf) {
+				st->validate_counters = SumCounters(st->validate_chunks);
+			}
+
 			b = std::chrono::steady_clock::now();
 
 			start[_set.size()] = length;
 			thr_num = _set.size();
 
 			LoadData2 p(pool.get());
+			p.control = control;
+			p.parse_stats = st;
+			p.chk_key_dup = option.chk_key_dup;
+			p.str_heap = option.str_heap;
+			p.lazy_number = option.lazy_number;
 						
 			if (false == p.parse(ut, d.pool, buf, buf_len, simdjson_imple_, length, start, count_vec,
 				thr_num)) // 0 : use all thread..
 			{
+				dup_key_path = std::move(p.dup_key_path);
 				free(count_vec);
 				return { false, 0 };
 			}
@@ -4617,8 +7249,14 @@ namespace claujson {
 	std::pair<bool, uint64_t> parser::parse_str(StringView str, Document& d, uint64_t thr_num)
 	{
 		_Value& ut = d.Get();
+		dup_key_path.clear();
 
-		log << info << str << "\n";
+		ParseStats* st = option.stats ? &stats : nullptr;
+		StatsScope<ParseStats> scope(st, option.perf_counters);
+		const bool perf = st && st->perf_counters;
+		TraceScope trace_scope("parse_str");
+
+		log << info << "parse_str " << str.size() << " bytes\n";
 
 		if (thr_num <= 0) {
 			thr_num = std::max((int)std::thread::hardware_concurrency() - 2, 1);
@@ -4628,11 +7266,16 @@ namespace claujson {
 			thr_num = 1;
 		}
 
+		Job job(pool.get(), thr_num, max_thr_num, !in_job);
+		thr_num = job.budget;
+
 		uint64_t length = 0;
 
 		auto _ = std::chrono::steady_clock::now();
 		uint64_t* count_vec = nullptr;
 		{
+			const uint64_t stage1_start = now_ns();
+			PerfScope stage1_perf(perf ? &st->stage1_counters : nullptr);
 			auto x = test_.parse(str.data(), str.length());
 
 			if (x.error() != _simdjson::error_code::SUCCESS) {
@@ -4644,6 +7287,33 @@ namespace claujson {
 			const auto& buf = test_.raw_buf();
 			const auto buf_len = test_.raw_len();
 			auto* simdjson_imple_ = test_.raw_implementation().get();
+			EndPhase("stage1", stage1_start, st ? &st->stage1_ns : nullptr);
+			stage1_perf.end();
+
+			if (control) {
+				control->total = buf_len;
+				if (control->is_cancelled()) {
+					log << info << "cancelled\n";
+					return { false, 0 };
+				}
+			}
+
+			thr_num = ChunkThreads(option, thr_num, simdjson_imple_->n_structural_indexes, buf_len);
+			// one thread : no chunks.
+			if (thr_num == 1 && simdjson_imple_->n_structural_indexes > 0) {
+				LoadData2 p(pool.get());
+				p.control = control;
+				p.parse_stats = st;
+				p.chk_key_dup = option.chk_key_dup;
+				p.str_heap = option.str_heap;
+				p.lazy_number = option.lazy_number;
+
+				if (false == p.parse_small(ut, d.pool, buf, buf_len, simdjson_imple_)) {
+					dup_key_path = std::move(p.dup_key_path);
+					return { false, 0 };
+				}
+				return { true, simdjson_imple_->n_structural_indexes };
+			}
 
 			my_vector<int64_t> start(thr_num + 1);
 			//my_vector<int> key;
@@ -4677,6 +7347,8 @@ namespace claujson {
 			//if (use_all_function)
 			
 			std::set<uint64_t> _set;
+			const uint64_t partition_start = now_ns();
+			uint64_t validate_start = 0;
 			{
 
 				
@@ -4717,23 +7389,33 @@ namespace claujson {
 				for (uint64_t i = 0; i < _set.size(); ++i) {
 					last[i] = start[i + 1];
 				}
+				validate_start = EndPhase("partition", partition_start, st ? &st->partition_ns : nullptr);
+				if (st) {
+					st->validate_chunks.resize(_set.size());
+				}
 
 				my_vector<Vector<int8_t>> is_array(_set.size()), is_virtual_array(_set.size());
-				my_vector<std::future<bool>> thr_result(_set.size());
 				count_vec = (uint64_t*)malloc(length * sizeof(uint64_t));
 				if (!count_vec) {
 					log << "malloc fail in parse_str function.";
 					return { false, -55 };
 				}
-				for (uint64_t i = 0; i < _set.size(); ++i) {
-					thr_result[i] = pool->enqueue(is_valid2, std::ref(test_), start[i], last[i], &start_state[i], &last_state[i],
-						&is_array[i], &is_virtual_array[i], count_vec);
-				}
 				my_vector<int> vec(_set.size());
 
-				for (uint64_t i = 0; i < _set.size(); ++i) {
-					vec[i] = (int)thr_result[i].get();
-				}
+				pool->parallel_for(0, _set.size(), [&](size_t i) {
+					TraceScope scope("is_valid2", i);
+					PerfScope perf_scope(perf ? &st->validate_chunks[i].counters : nullptr);
+					const uint64_t chunk_start = st ? now_ns() : 0;
+					vec[i] = (int)is_valid2(test_, start[i], last[i], &start_state[i], &last_state[i],
+						&is_array[i], &is_virtual_array[i], count_vec);
+					if (st) {
+						ParseStats::Chunk& c = st->validate_chunks[i];
+						c.tokens = last[i] - start[i];
+						c.bytes = simdjson_imple_->structural_indexes[last[i]] - simdjson_imple_->structural_indexes[start[i]];
+						c.ns = now_ns() - chunk_start;
+						c.worker = pool->worker_index();
+					}
+				});
 
 				bool result = true;
 
@@ -4796,16 +7478,27 @@ namespace claujson {
 			dur = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - b);
 			log << info << dur.count() << "ms\n";
 
+			EndPhase("validate", validate_start, st ? &st->validate_ns : nullptr);
+			if (perf) {
+				st->validate_counters = SumCounters(st->validate_chunks);
+			}
+
 			b = std::chrono::steady_clock::now();
 
 			start[_set.size()] = length;
 			thr_num = _set.size();
 
 			LoadData2 p(pool.get());
+			p.control = control;
+			p.parse_stats = st;
+			p.chk_key_dup = option.chk_key_dup;
+			p.str_heap = option.str_heap;
+			p.lazy_number = option.lazy_number;
 
 			if (false == p.parse(ut, d.pool, buf, buf_len, simdjson_imple_, length, start, count_vec,
 				thr_num)) // 0 : use all thread..
 			{
+				dup_key_path = std::move(p.dup_key_path);
 				free(count_vec);
 				return { false, 0 };
 			}
@@ -4828,32 +7521,332 @@ namespace claujson {
 	}
 #endif
 
-	writer::writer(int thr_num) {
-		pool = pool_init(thr_num);
+	template<class S, class P>
+	std::vector<Document> parser::_parse_batch(uint64_t n, S&& size, P&& parse_one, uint64_t thr_num,
+		std::vector<std::pair<bool, uint64_t>>* result) {
+		if (thr_num <= 0) {
+			thr_num = std::max((int)std::thread::hardware_concurrency() - 2, 1);
+		}
+
+		TraceScope scope("parse_batch");
+
+		std::vector<Document> docs(n);
+		std::vector<std::pair<bool, uint64_t>> _result(n, { false, 0 });
+
+		std::vector<uint64_t> whole, split;
+		std::vector<uint64_t> bytes(n);
+		for (uint64_t i = 0; i < n; ++i) {
+			bytes[i] = size(i);
+			if (option.batch_split_size > 0 && bytes[i] >= option.batch_split_size) {
+				split.push_back(i);
+			}
+			else {
+				whole.push_back(i);
+			}
+		}
+		// bigger first, then small ones fill the gaps at the end.
+		std::stable_sort(whole.begin(), whole.end(), [&](uint64_t a, uint64_t b) { return bytes[a] > bytes[b]; });
+
+		// one job for the batch, parses of documents are in it.
+		Job job(pool.get(), thr_num, max_thr_num);
+		{
+			const uint64_t lanes = std::min<uint64_t>(job.budget, whole.size());
+			std::atomic<uint64_t> next{ 0 };
+
+			// one parser (scanner) per lane, a document in one thread.
+			pool->parallel_for(0, lanes, [&](size_t) {
+				parser p(1);
+				p.option = option;
+				p.in_job = true;
+				for (uint64_t k = next.fetch_add(1); k < whole.size(); k = next.fetch_add(1)) {
+					const uint64_t i = whole[k];
+					TraceScope doc_scope("batch_doc", i);
+					_result[i] = parse_one(p, i, docs[i], 1);
+				}
+			});
+		}
+
+		in_job = true;
+		for (uint64_t i : split) {
+			_result[i] = parse_one(*this, i, docs[i], job.budget);
+		}
+		in_job = false;
+
+		if (result) {
+			*result = std::move(_result);
+		}
+		return docs;
+	}
+
+	std::vector<Document> parser::parse_batch(const std::vector<std::string>& fileNames, uint64_t thr_num,
+		std::vector<std::pair<bool, uint64_t>>* result) {
+		return _parse_batch(fileNames.size(),
+			[&](uint64_t i) -> uint64_t {
+				std::ifstream in(fileNames[i], std::ios::binary | std::ios::ate);
+				const auto len = in ? (int64_t)in.tellg() : 0;
+				return len > 0 ? len : 0;
+			},
+			[&](parser& p, uint64_t i, Document& d, uint64_t thr_num) {
+				return p.parse(fileNames[i], d, thr_num);
+			}, thr_num, result);
+	}
+
+	std::vector<Document> parser::parse_str_batch(const std::vector<StringView>& strs, uint64_t thr_num,
+		std::vector<std::pair<bool, uint64_t>>* result) {
+		return _parse_batch(strs.size(),
+			[&](uint64_t i) -> uint64_t {
+				return strs[i].size();
+			},
+			[&](parser& p, uint64_t i, Document& d, uint64_t thr_num) {
+				return p.parse_str(strs[i], d, thr_num);
+			}, thr_num, result);
+	}
+
+	Async<std::pair<bool, uint64_t>> parser::parse_async(const std::string& fileName, Document& d, uint64_t thr_num) {
+		Async<std::pair<bool, uint64_t>> result;
+		auto state = result.state;
+		state->pool = pool.get();
+		pool->enqueue([this, fileName, &d, thr_num, state]() {
+			std::pair<bool, uint64_t> x{ false, 0 };
+			std::exception_ptr error;
+			control = &state->control;
+			try {
+				x = parse(fileName, d, thr_num);
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			control = nullptr;
+			if (x.first) {
+				state->control.done = state->control.total.load();
+			}
+			state->set(x, error);
+		});
+		return result;
+	}
+
+	Async<std::pair<bool, uint64_t>> parser::parse_str_async(StringView str, Document& d, uint64_t thr_num) {
+		Async<std::pair<bool, uint64_t>> result;
+		auto state = result.state;
+		state->pool = pool.get();
+		pool->enqueue([this, str, &d, thr_num, state]() {
+			std::pair<bool, uint64_t> x{ false, 0 };
+			std::exception_ptr error;
+			control = &state->control;
+			try {
+				x = parse_str(str, d, thr_num);
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			control = nullptr;
+			if (x.first) {
+				state->control.done = state->control.total.load();
+			}
+			state->set(x, error);
+		});
+		return result;
+	}
+
+	bool parser::_reformat(const std::string& outFileName, OutputSink* sink, bool pretty, uint64_t thr_num) {
+		if (thr_num <= 0) {
+			thr_num = std::max((int)std::thread::hardware_concurrency() - 2, 1);
+		}
+		if (thr_num <= 0) {
+			thr_num = 1;
+		}
+
+		Job job(pool.get(), thr_num, max_thr_num);
+		thr_num = job.budget;
+
+		const uint64_t length = test_.raw_implementation()->n_structural_indexes;
+		if (length == 0) {
+			log << warn << "empty string is not valid json";
+			return false;
+		}
+
+		auto a = std::chrono::steady_clock::now();
+		if (!is_valid_parallel(pool.get(), test_, length, thr_num)) {
+			log << warn << "not valid json\n";
+			return false;
+		}
+		auto b = std::chrono::steady_clock::now();
+		auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		log << info << "valid " << dur.count() << "ms\n";
+
+		LoadData2 p(pool.get());
+		return p.reformat(test_.raw_buf(), test_.raw_len(), test_.raw_implementation().get(), thr_num, pretty, outFileName, sink);
+	}
+
+	bool parser::reformat(const std::string& fileName, const std::string& outFileName, bool pretty, uint64_t thr_num) {
+		auto x = test_.load(fileName);
+		if (x.error() != _simdjson::error_code::SUCCESS) {
+			log << warn << "stage1 error : ";
+			log << warn << x.error() << "\n";
+			return false;
+		}
+		return _reformat(outFileName, nullptr, pretty, thr_num);
+	}
+
+	bool parser::reformat(const std::string& fileName, OutputSink& sink, bool pretty, uint64_t thr_num) {
+		auto x = test_.load(fileName);
+		if (x.error() != _simdjson::error_code::SUCCESS) {
+			log << warn << "stage1 error : ";
+			log << warn << x.error() << "\n";
+			return false;
+		}
+		return _reformat(std::string(), &sink, pretty, thr_num);
+	}
+
+	bool parser::reformat_str(StringView str, std::string& out, bool pretty, uint64_t thr_num) {
+		auto x = test_.parse(str.data(), str.length());
+		if (x.error() != _simdjson::error_code::SUCCESS) {
+			log << warn << "stage1 error : ";
+			log << warn << x.error() << "\n";
+			return false;
+		}
+		out.clear();
+		BufferSink sink(out);
+		return _reformat(std::string(), &sink, pretty, thr_num);
+	}
+
+	writer::writer(int thr_num) : max_thr_num(thr_num > 0 ? thr_num : 0) {
+		pool = shared_pool();
 	}
 		
 	std::string writer::write_to_str(const _Value& global, bool pretty) {
-		LoadData2 p(pool.get()); 
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		LoadData2 p(pool.get(), &stats); 
 		return p.write_to_str(global, pretty);
 	}
 
 	std::string writer::write_to_str2(const _Value& global, bool pretty) {
-		LoadData2 p(pool.get());
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		LoadData2 p(pool.get(), &stats);
 		return p.write_to_str2(global, pretty);
 	}
 
-	void writer::write(const std::string& fileName, const _Value& global, bool pretty) {
-		LoadData2 p(pool.get());
-		p.write(fileName, global, pretty, false);
+	bool writer::write(const std::string& fileName, const _Value& global, bool pretty) {
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		LoadData2 p(pool.get(), &stats);
+		return p.write(fileName, global, pretty, false);
+	}
+
+	bool writer::write_parallel(Arena* memory_pool, const std::string& fileName, _Value& j, uint64_t thr_num, bool pretty) {
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		Job job(pool.get(), thr_num, max_thr_num);
+		LoadData2 p(pool.get(), &stats); 
+		return p.write_parallel(memory_pool, fileName, j, job.budget, pretty);
+	}
+	bool writer::write_parallel2(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty) {
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		Job job(pool.get(), thr_num, max_thr_num);
+		LoadData2 p(pool.get(), &stats); 
+		return p.write_parallel2(fileName, j, job.budget, pretty);
+	}
+	bool writer::write_parallel3(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty) {
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		Job job(pool.get(), thr_num, max_thr_num);
+		LoadData2 p(pool.get(), &stats);
+		p.control = control;
+		return p.write_parallel3(fileName, j, job.budget, pretty);
+	}
+	bool writer::write_parallel_stream(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty, uint64_t buf_size) {
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		Job job(pool.get(), thr_num, max_thr_num);
+		LoadData2 p(pool.get(), &stats);
+		return p.write_parallel_stream(fileName, j, job.budget, pretty, buf_size);
+	}
+
+	bool writer::write(OutputSink& sink, const _Value& global, bool pretty) {
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		LoadData2 p(pool.get(), &stats);
+		return p.write(sink, global, pretty);
+	}
+	bool writer::write_parallel(Arena* memory_pool, OutputSink& sink, _Value& j, uint64_t thr_num, bool pretty) {
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		Job job(pool.get(), thr_num, max_thr_num);
+		LoadData2 p(pool.get(), &stats);
+		return p.write_parallel(memory_pool, std::string(), j, job.budget, pretty, &sink);
+	}
+	bool writer::write_parallel2(OutputSink& sink, const _Value& j, uint64_t thr_num, bool pretty) {
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		Job job(pool.get(), thr_num, max_thr_num);
+		LoadData2 p(pool.get(), &stats);
+		return p.write_parallel2(std::string(), j, job.budget, pretty, &sink);
+	}
+	bool writer::write_parallel3(OutputSink& sink, const _Value& j, uint64_t thr_num, bool pretty) {
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		Job job(pool.get(), thr_num, max_thr_num);
+		LoadData2 p(pool.get(), &stats);
+		p.control = control;
+		return p.write_parallel3(std::string(), j, job.budget, pretty, &sink);
+	}
+	bool writer::write_parallel_stream(OutputSink& sink, const _Value& j, uint64_t thr_num, bool pretty, uint64_t buf_size) {
+		StatsScope<WriteStats> scope(&stats, perf_counters);
+		Job job(pool.get(), thr_num, max_thr_num);
+		LoadData2 p(pool.get(), &stats);
+		return p.write_parallel_stream(std::string(), j, job.budget, pretty, buf_size, &sink);
 	}
 
-	void writer::write_parallel(Arena* memory_pool, const std::string& fileName, _Value& j, uint64_t thr_num, bool pretty) {
-		LoadData2 p(pool.get()); 
-		p.write_parallel(memory_pool, fileName, j, thr_num, pretty);
+	Async<bool> writer::write_async(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty) {
+		Async<bool> result;
+		auto state = result.state;
+		state->pool = pool.get();
+		pool->enqueue([this, fileName, &j, thr_num, pretty, state]() {
+			std::exception_ptr error;
+			bool ok = false;
+			control = &state->control;
+			try {
+				ok = write_parallel3(fileName, j, thr_num, pretty);
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			control = nullptr;
+			state->set(ok && !state->control.is_cancelled(), error);
+		});
+		return result;
 	}
-	void writer::write_parallel2(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty) {
-		LoadData2 p(pool.get()); 
-		p.write_parallel2(fileName, j, thr_num, pretty);
+	Async<bool> writer::write_async(OutputSink& sink, const _Value& j, uint64_t thr_num, bool pretty) {
+		Async<bool> result;
+		auto state = result.state;
+		state->pool = pool.get();
+		pool->enqueue([this, &sink, &j, thr_num, pretty, state]() {
+			std::exception_ptr error;
+			bool ok = false;
+			control = &state->control;
+			try {
+				ok = write_parallel3(sink, j, thr_num, pretty);
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			control = nullptr;
+			state->set(ok && !state->control.is_cancelled(), error);
+		});
+		return result;
+	}
+
+	bool FdSink::write(const char* data, uint64_t len) {
+		while (len > 0) {
+#if CLAUJSON_USE_PWRITE
+			ssize_t n = ::write(fd, data, len);
+#else
+			int n = ::_write(fd, data, static_cast<unsigned int>(std::min<uint64_t>(len, 1 << 30)));
+#endif
+			if (n < 0) {
+#if CLAUJSON_USE_PWRITE
+				if (errno == EINTR) {
+					continue;
+				}
+#endif
+				return false;
+			}
+			data += n;
+			len -= n;
+		}
+		return true;
 	}
 
 	static std::string escape_for_json_pointer(std::string str) {
@@ -5366,20 +8359,12 @@ namespace claujson {
 		}
 	}
 
-	[[nodiscard]]
-	std::unique_ptr<ThreadPool> pool_init(int thr_num) {
-		if (thr_num <= 0) {
-			thr_num = std::max((int)std::thread::hardware_concurrency() - 2, 1);
-
-		}
-		if (thr_num <= 0) {
-			thr_num = 1;
-		}
 
-		return std::make_unique<ThreadPool>(thr_num);
+	bool has_escape_char(StringView x) {
+		const char* end = x.data() + x.size();
+		return find_escape(x.data(), end) != end;
 	}
 
-
 	bool is_valid_string_in_json(StringView x) {
 		const char* str = x.data();
 		uint64_t len = x.size();
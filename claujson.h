@@ -7,6 +7,13 @@
 
 #include "thread_pool.h"
 
+#include <cassert>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#define CLAUJSON_COROUTINE 1
+#endif
+
 #include "_simdjson.h" // modified simdjson // using simdjson 3.12.3
 
 namespace claujson {
@@ -49,6 +56,7 @@ namespace claujson {
 					PartialJson* _pj_ptr;
 					String* _str_val;
 					bool _bool_val;
+					const char* _num_str; // lazy number`s text, temp is its length.
 				};
 				uint32_t temp;
 				_ValueType _type;
@@ -171,11 +179,32 @@ namespace claujson {
 		template <typename T>
 		T get_number() const {
 			if (is_float()) {
-				return static_cast<T>(_float_val);
+				return static_cast<T>(float_val());
 			}
-			return static_cast<T>(_uint_val);
+			return static_cast<T>(uint_val());
 		}
 
+		// number from parse with ParseOption::lazy_number, not decoded yet. (temp != 0)
+		// const getters decode every call, non-const getters decode once and drop the text.
+		bool is_lazy_number() const {
+			return temp != 0 && (_type == _ValueType::INT || _type == _ValueType::UINT || _type == _ValueType::FLOAT);
+		}
+
+		// original text of lazy number.
+		StringView get_number_text() const {
+			if (!is_lazy_number()) {
+				return StringView();
+			}
+			return StringView(_num_str, temp);
+		}
+
+		// str is not copied, type is INT or FLOAT.
+		void set_lazy_number_in_parse(const char* str, uint32_t len, _ValueType type);
+	private:
+		uint64_t decode_lazy_number() const;
+		void materialize_number();
+	public:
+
 		double float_val() const;
 
 		int64_t& int_val();
@@ -374,7 +403,22 @@ namespace claujson {
 		}
 
 		~Document() noexcept;
+
+		// moved-from Document has no arena, it can be destroyed or assigned only.
+		Document(Document&& other) noexcept : x(std::move(other.x)), pool(other.pool) {
+			other.pool = nullptr;
+		}
+		Document& operator=(Document&& other) noexcept {
+			if (this != &other) {
+				delete pool;
+				x = std::move(other.x);
+				pool = other.pool;
+				other.pool = nullptr;
+			}
+			return *this;
+		}
 	public:
+		Document(const Document&) = delete;
 		Document& operator=(const Document&) = delete;
 		Document(const _Value&) = delete;
 	public:
@@ -567,7 +611,16 @@ namespace claujson {
 
 		void reserve_data_list(uint64_t sz);
 
+		uint64_t get_node_count() const; // 0 : not known or pj.
 	private:
+		// cached node count of x, or count it. 1 for primitives.
+		static uint64_t node_count(const _Value& x);
+		// add delta to cached node counts of this and its parents, if known.
+		void add_node_count(int64_t delta);
+		// x is added to (or removed from) this.
+		void add_node_count(const _Value& x) { if (get_node_count() != 0) { add_node_count(static_cast<int64_t>(node_count(x))); } }
+		void sub_node_count(const _Value& x) { if (get_node_count() != 0) { add_node_count(-static_cast<int64_t>(node_count(x))); } }
+
 		// need rename param....!
 		void add_item_type(int64_t key_buf_idx, int64_t key_next_buf_idx, int64_t val_buf_idx, int64_t val_next_buf_idx,
 			char* buf, uint64_t key_token_idx, uint64_t val_token_idx, Arena* pool);
@@ -605,13 +658,236 @@ namespace claujson {
 
 namespace claujson {
 
+	struct ParseOption {
+		// detect duplicate keys while parsing, then parse fails. (see parser::get_dup_key_path)
+		bool chk_key_dup = false;
+		// long string`s bytes are appended to contiguous string heap per chunk. (Arena::use_str_heap)
+		bool str_heap = false;
+		// keep number`s text, decode when used. writer writes the text if not modified. (_Value::is_lazy_number)
+		bool lazy_number = false;
+		// min tokens or bytes per chunk, a parse uses at most max(tokens / chunk_min_tokens, bytes / chunk_min_bytes) threads.
+		//  0 (either) : no limit. if it is one thread, input is parsed without chunks and merge.
+		//  uncalibrated defaults : not measured on a multi-core host, run main.cpp --small there to set them.
+		uint64_t chunk_min_tokens = 8192;
+		uint64_t chunk_min_bytes = 1 << 16;
+		// parse_batch : inputs of this size (bytes) or more are parsed one by one in chunks, not in a worker. 0 : never.
+		uint64_t batch_split_size = 1 << 24;
+		// fill ParseStats. (parser::get_stats)
+		bool stats = false;
+		// with stats, hardware counters of phases too. (Linux)
+		bool perf_counters = false;
+	};
+
+	// hardware counters of this process in user mode, by perf_event_open. (Linux)
+	//  0 if one is not supported. (ex) virtual machine)
+	struct PerfCounters {
+		uint64_t cycles = 0;
+		uint64_t instructions = 0;
+		uint64_t llc_misses = 0;
+		uint64_t branch_misses = 0;
+		uint64_t dtlb_misses = 0;
+	};
+
+	// of last parse, if ParseOption::stats. times in nanoseconds.
+	struct ParseStats {
+		// of one validation or build chunk.
+		struct Chunk {
+			uint64_t tokens = 0;
+			uint64_t bytes = 0;
+			uint64_t ns = 0;
+			int64_t worker = -1; // index of pool worker, -1 : caller thread.
+			PerfCounters counters; // on the thread which ran it.
+		};
+
+		uint64_t total_ns = 0;
+		uint64_t stage1_ns = 0; // parse : with file read. (in simdjson load)
+		uint64_t partition_ns = 0; // tokens -> chunks.
+		uint64_t validate_ns = 0; // is_valid2 of chunks, and states between chunks.
+		uint64_t build_ns = 0; // __LoadData of chunks. (one thread : validate and build at once)
+		uint64_t merge_ns = 0;
+		uint64_t link_ns = 0; // arenas of chunks -> arena of Document.
+		uint64_t finish_ns = 0; // node counts of containers over chunks, duplicate keys over chunks.
+
+		std::vector<Chunk> validate_chunks;
+		std::vector<Chunk> build_chunks;
+		uint64_t threads = 0; // ran build chunks.
+		double utilization = 0; // sum of build chunk ns / (build_ns * threads)
+
+		uint64_t arenas = 0; // of chunks.
+		uint64_t arena_blocks = 0; // blocks allocated by all arenas, calls at the same time are counted too.
+
+		// ParseOption::perf_counters, and perf_event_open works.
+		bool perf_counters = false;
+		PerfCounters stage1_counters;
+		PerfCounters validate_counters; // sum of validate chunks.
+		PerfCounters build_counters; // sum of build chunks.
+		PerfCounters merge_counters;
+	};
+
+	// parsers and writers share one thread pool. (created by first parser or writer, gone with last one)
+	struct SchedulerOption {
+		// worker threads, 0 : hardware_concurrency() - 2. (at least 1)
+		int thr_num = 0;
+		// max threads one parse or write call uses at the same time (caller included), 0 : no limit.
+		int max_budget = 0;
+		// running calls share workers evenly, a call started later gets 1 + workers / running calls.
+		bool fair = true;
+		// pin workers to cpus, spread over NUMA nodes. (Linux)
+		//  parse chunk i is built on node i * nodes / chunks (its arena is allocated there),
+		//  write_parallel3 writes a range on the node of its memory.
+		bool numa = false;
+	};
+
+	// false if shared pool is in use, then option is not changed.
+	bool set_scheduler_option(const SchedulerOption& option);
+	SchedulerOption get_scheduler_option();
+
+	// allowed cpus of each NUMA node, from /sys/devices/system/node. empty if unknown.
+	std::vector<std::vector<int>> numa_cpus();
+
+	// progress and cancel of one async call. (parse_async, write_async)
+	class AsyncControl {
+	public:
+		// the call stops at next check (between chunks), then parse returns false, writer writes nothing.
+		void cancel() { cancelled.store(true); }
+		bool is_cancelled() const { return cancelled.load(std::memory_order_relaxed); }
+
+		// parse : bytes of input built into tree, of input size.
+		// write : bytes of output made in memory, of estimated output size. (total is 0 until it is known)
+		uint64_t done_bytes() const { return done.load(std::memory_order_relaxed); }
+		uint64_t total_bytes() const { return total.load(std::memory_order_relaxed); }
+	private:
+		friend class parser;
+		friend class writer;
+		friend class LoadData2;
+
+		std::atomic<bool> cancelled{ false };
+		std::atomic<uint64_t> done{ 0 };
+		std::atomic<uint64_t> total{ 0 };
+	};
+
+	// result of async call running on the shared pool. like std::future, get() waits and can be called once.
+	//  C++20 : co_await it, the coroutine is resumed in a new task of the shared pool. (not in the finished call)
+	//   it runs on a worker, so code after co_await should not block waiting for other tasks of the pool.
+	template<class T>
+	class Async {
+	private:
+		struct State {
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool ready = false;
+			T value{};
+			std::exception_ptr error;
+			std::function<void()> then; // resumes awaiting coroutine.
+			ThreadPool* pool = nullptr; // then is run here, set by parser, writer.
+			AsyncControl control;
+
+			void set(T x, std::exception_ptr e) {
+				std::function<void()> f;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					value = std::move(x);
+					error = e;
+					ready = true;
+					f = std::move(then);
+				}
+				condition.notify_all();
+				if (!f) {
+					return;
+				}
+				if (pool) {
+					try {
+						pool->enqueue(f);
+						return;
+					}
+					catch (...) { // pool is stopping.
+					}
+				}
+				f();
+			}
+		};
+		std::shared_ptr<State> state;
+		std::shared_ptr<AsyncControl> _control; // part of state, also after get().
+
+		friend class parser;
+		friend class writer;
+	public:
+		Async() : state(std::make_shared<State>()), _control(state, &state->control) { }
+
+		// false after get().
+		bool valid() const { return state != nullptr; }
+
+		// is_ready, wait, get : only if valid().
+		bool is_ready() const {
+			assert(valid());
+			std::unique_lock<std::mutex> lock(state->mutex);
+			return state->ready;
+		}
+		void wait() const {
+			assert(valid());
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->condition.wait(lock, [this] { return state->ready; });
+		}
+		// rethrows exception of the call.
+		T get() {
+			wait();
+			std::shared_ptr<State> x = std::move(state);
+			if (x->error) {
+				std::rethrow_exception(x->error);
+			}
+			return std::move(x->value);
+		}
+
+		AsyncControl& control() { return *_control; }
+		const AsyncControl& control() const { return *_control; }
+
+#if CLAUJSON_COROUTINE
+		bool await_ready() const { return is_ready(); }
+		bool await_suspend(std::coroutine_handle<> h) {
+			std::unique_lock<std::mutex> lock(state->mutex);
+			if (state->ready) {
+				return false; // go on, not suspended.
+			}
+			state->then = [h] { h.resume(); };
+			return true;
+		}
+		T await_resume() { return get(); }
+#endif
+	};
+
+	class OutputSink;
+
 	class parser {
 	private:
 		_simdjson::dom::parser_for_claujson test_;
-		std::unique_ptr<ThreadPool> pool;
+		std::shared_ptr<ThreadPool> pool;
+		uint64_t max_thr_num; // of one call.
+		ParseOption option;
+		std::string dup_key_path;
+		AsyncControl* control = nullptr; // of parse_async running now.
+		ParseStats stats;
+		bool in_job = false; // parse in _parse_batch, counted in the job of the batch.
+
+		// after stage1.
+		bool _reformat(const std::string& outFileName, OutputSink* sink, bool pretty, uint64_t thr_num);
+
+		// size(i) : bytes of i-th input, parse_one(p, i, d, thr_num) : parse i-th input with parser p.
+		template<class S, class P>
+		std::vector<Document> _parse_batch(uint64_t n, S&& size, P&& parse_one, uint64_t thr_num,
+			std::vector<std::pair<bool, uint64_t>>* result);
 	public:
+		// thr_num : max threads one call uses, 0 : no limit. (thr_num of call, SchedulerOption)
 		parser(int thr_num = 0);
 	public:
+		void set_option(const ParseOption& option) { this->option = option; }
+		const ParseOption& get_option() const { return option; }
+
+		// json pointer of first duplicate key found by last parse, empty if not found.
+		const std::string& get_dup_key_path() const { return dup_key_path; }
+
+		// of last parse or parse_str, if ParseOption::stats.
+		const ParseStats& get_stats() const { return stats; }
+
 		// parse json file.
 		std::pair<bool, uint64_t> parse(const std::string& fileName, Document& d, uint64_t thr_num);
 
@@ -624,21 +900,161 @@ namespace claujson {
 		// C++20~
 		std::pair<bool, uint64_t> parse_str(std::u8string_view str, Document& d, uint64_t thr_num);
 #endif
+
+		// parse or parse_str on the shared pool, returns at once. (cancel : { false, 0 })
+		//  this parser, d and str must live until it is ready, and this parser is not used until then.
+		Async<std::pair<bool, uint64_t>> parse_async(const std::string& fileName, Document& d, uint64_t thr_num);
+		Async<std::pair<bool, uint64_t>> parse_str_async(StringView str, Document& d, uint64_t thr_num);
+
+		// many documents : whole documents are parsed by workers at the same time, each worker has its own scanner,
+		//  each document has its own arena. bigger ones first. (ParseOption::batch_split_size or more : after them, in chunks)
+		//  result[i] : return value of parse or parse_str for i-th input, if result is not nullptr.
+		std::vector<Document> parse_batch(const std::vector<std::string>& fileNames, uint64_t thr_num,
+			std::vector<std::pair<bool, uint64_t>>* result = nullptr);
+		std::vector<Document> parse_str_batch(const std::vector<StringView>& strs, uint64_t thr_num,
+			std::vector<std::pair<bool, uint64_t>>* result = nullptr);
+
+		// json to minified or pretty (same layout as writer) json, without Document. (no tree, no Arena)
+		//  strings and numbers are copied as they are, not unescaped or converted. false if not valid json.
+		bool reformat(const std::string& fileName, const std::string& outFileName, bool pretty, uint64_t thr_num);
+		bool reformat(const std::string& fileName, OutputSink& sink, bool pretty, uint64_t thr_num);
+		bool reformat_str(StringView str, std::string& out, bool pretty, uint64_t thr_num);
+	};
+
+	// output of writer, write is called in order. (from one thread at a time)
+	class OutputSink {
+	public:
+		virtual ~OutputSink() = default;
+		// false -> error, writer does not call write again.
+		virtual bool write(const char* data, uint64_t len) = 0;
+		// about len bytes will be written. (estimate)
+		virtual void reserve(uint64_t len) { }
+	};
+
+	// append to caller`s buffer. output is formatted in writer`s buffers, then copied here once.
+	//  (out is reserved from estimated size, not grown by copies)
+	class BufferSink : public OutputSink {
+	private:
+		std::string& out;
+	public:
+		explicit BufferSink(std::string& out) : out(out) { }
+
+		bool write(const char* data, uint64_t len) override {
+			out.append(data, len);
+			return true;
+		}
+		void reserve(uint64_t len) override {
+			out.reserve(out.size() + len);
+		}
+	};
+
+	// file descriptor or socket, not closed by sink.
+	class FdSink : public OutputSink {
+	private:
+		int fd;
+	public:
+		explicit FdSink(int fd) : fd(fd) { }
+
+		bool write(const char* data, uint64_t len) override;
+	};
+
+	class OStreamSink : public OutputSink {
+	private:
+		std::ostream& out;
+	public:
+		explicit OStreamSink(std::ostream& out) : out(out) { }
+
+		bool write(const char* data, uint64_t len) override {
+			out.write(data, len);
+			return static_cast<bool>(out);
+		}
+	};
+
+	// receives completed chunks.
+	class CallbackSink : public OutputSink {
+	private:
+		std::function<bool(const char*, uint64_t)> func;
+	public:
+		explicit CallbackSink(std::function<bool(const char*, uint64_t)> func) : func(std::move(func)) { }
+
+		bool write(const char* data, uint64_t len) override {
+			return func(data, len);
+		}
+	};
+
+	// of last write, output buffers are presized by estimated output size.
+	struct WriteStats {
+		uint64_t estimated_size = 0; // bytes, 0 : not estimated. (write_parallel_stream, write to sink in chunks)
+		uint64_t output_size = 0; // bytes, of presized buffers.
+		uint64_t buffer_count = 0; // presized buffers.
+		uint64_t buffer_grow_count = 0; // buffers grown over presized capacity.
+
+		// of one range of output, write_parallel3.
+		struct Chunk {
+			uint64_t bytes = 0;
+			uint64_t ns = 0;
+			int64_t worker = -1; // index of pool worker, -1 : caller thread.
+			PerfCounters counters; // on the thread which ran it.
+		};
+
+		// nanoseconds.
+		uint64_t total_ns = 0;
+		uint64_t split_ns = 0; // tree -> ranges.
+		uint64_t presize_ns = 0; // estimate output size, reserve buffers.
+		uint64_t write_ns = 0; // ranges -> text, in parallel.
+		uint64_t output_ns = 0; // text -> file or sink.
+
+		std::vector<Chunk> chunks;
+		uint64_t threads = 0; // ran chunks.
+		double utilization = 0; // sum of chunk ns / (write_ns * threads)
+
+		uint64_t arena_blocks = 0; // blocks allocated by all arenas, calls at the same time are counted too.
+
+		// writer::set_perf_counters, and perf_event_open works.
+		bool perf_counters = false;
+		PerfCounters write_counters; // sum of chunks.
 	};
 
 	class writer {
 	private:
-		std::unique_ptr<ThreadPool> pool;
+		std::shared_ptr<ThreadPool> pool;
+		uint64_t max_thr_num; // of one call.
+		WriteStats stats;
+		AsyncControl* control = nullptr; // of write_async running now.
+		bool perf_counters = false;
 	public:
+		// thr_num : max threads one call uses, 0 : no limit. (thr_num of call, SchedulerOption)
 		writer(int thr_num = 0);
 	public:
+		const WriteStats& get_stats() const { return stats; }
+		// hardware counters in WriteStats. (Linux, write_parallel3)
+		void set_perf_counters(bool x) { perf_counters = x; }
+
 		std::string write_to_str(const _Value& global, bool prettty = false);
 		std::string write_to_str2(const _Value& global, bool prettty = false);
 
-		void write(const std::string& fileName, const _Value& global, bool pretty = false);
+		// false if output fails. (open, write, sink)
+		bool write(const std::string& fileName, const _Value& global, bool pretty = false);
+
+		bool write_parallel(Arena* pool, const std::string& fileName, _Value& j, uint64_t thr_num, bool pretty = false);
+		bool write_parallel2(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty = false);
+		// const j, does not divide the tree.
+		bool write_parallel3(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty = false);
+		// const j, output memory is at most (2 * threads + 3) buffers of about buf_size. (a buffer is full at buf_size + last value)
+		bool write_parallel_stream(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty = false, uint64_t buf_size = 1 << 22);
 
-		void write_parallel(Arena* pool, const std::string& fileName, _Value& j, uint64_t thr_num, bool pretty = false);
-		void write_parallel2(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty = false);
+		// to sink, in chunks. (whole output is not in memory at once)
+		bool write(OutputSink& sink, const _Value& global, bool pretty = false);
+
+		bool write_parallel(Arena* pool, OutputSink& sink, _Value& j, uint64_t thr_num, bool pretty = false);
+		bool write_parallel2(OutputSink& sink, const _Value& j, uint64_t thr_num, bool pretty = false);
+		bool write_parallel3(OutputSink& sink, const _Value& j, uint64_t thr_num, bool pretty = false);
+		bool write_parallel_stream(OutputSink& sink, const _Value& j, uint64_t thr_num, bool pretty = false, uint64_t buf_size = 1 << 22);
+
+		// write_parallel3 on the shared pool, returns at once. false if cancelled (then nothing is written) or output fails.
+		//  this writer, j and sink must live until it is ready, and this writer is not used until then.
+		Async<bool> write_async(const std::string& fileName, const _Value& j, uint64_t thr_num, bool pretty = false);
+		Async<bool> write_async(OutputSink& sink, const _Value& j, uint64_t thr_num, bool pretty = false);
 	};
 
 
@@ -657,6 +1073,9 @@ namespace claujson {
 
 	bool is_valid_string_in_json(StringView x);
 
+	// has '"', '\\', control char or 0x7F. (needs escape in json)
+	bool has_escape_char(StringView x);
+
 #if __cpp_lib_char8_t
 	std::pair<bool, std::string> convert_to_string_in_json(std::u8string_view x);
 
@@ -19,6 +19,7 @@ namespace claujson {
 			auto x = this->get_value_list(i).clone(pool);
 			result.as_array()->add_element(std::move(x));
 		}
+		result.as_array()->_node_count = _node_count;
 
 		return result;
 	}
@@ -133,13 +134,18 @@ namespace claujson {
 	}
 
 	void Array::clear(uint64_t idx) {
+		StructuredPtr(this).sub_node_count(arr_vec[idx]);
 		arr_vec[idx].clear(false);
+		StructuredPtr(this).add_node_count(arr_vec[idx]);
 	}
 
 	bool Array::is_virtual() const {
 		return _is_virtual;
 	}
 	void Array::clear() {
+		if (_node_count != 0) {
+			StructuredPtr(this).add_node_count(1 - static_cast<int64_t>(_node_count));
+		}
 		arr_vec.clear();
 	}
 
@@ -166,7 +172,8 @@ namespace claujson {
 	}
 
 	bool Array::add_element(Value val) {
-		
+		StructuredPtr(this).add_node_count(val.Get());
+
 		if (val.Get().is_array()) {
 			val.Get().as_array()->set_parent(this);
 		}
@@ -180,6 +187,8 @@ namespace claujson {
 	}
 
 	bool Array::assign_element(uint64_t idx, Value val) {
+		StructuredPtr(this).sub_node_count(arr_vec[idx]);
+		StructuredPtr(this).add_node_count(val.Get());
 		if (val.Get().is_array()) {
 			val.Get().as_array()->set_parent(this);
 		}
@@ -214,6 +223,7 @@ namespace claujson {
 	}
 
 	void Array::erase(uint64_t idx, bool real) {
+		StructuredPtr(this).sub_node_count(arr_vec[idx]);
 
 		if (real) {
 			clean(arr_vec[idx]);
@@ -237,6 +247,15 @@ namespace claujson {
 		}
 
 		if (x->arr_vec.empty() == false) {
+			if (_node_count != 0) {
+				int64_t count = 0;
+				for (uint64_t i = start_offset; i < x->arr_vec.size(); ++i) {
+					if (!x->arr_vec[i].is_virtual()) { // merged by its own MergeWith.
+						count += StructuredPtr::node_count(x->arr_vec[i]);
+					}
+				}
+				StructuredPtr(this).add_node_count(count);
+			}
 			arr_vec.insert((x->arr_vec.begin()) + start_offset,
 				(x->arr_vec.end()));
 		}
@@ -270,6 +289,15 @@ namespace claujson {
 		}
 
 		if (x->arr_vec.empty() == false) {
+			if (_node_count != 0) {
+				int64_t count = 0;
+				for (uint64_t i = start_offset; i < x->arr_vec.size(); ++i) {
+					if (!x->arr_vec[i].is_virtual()) { // merged by its own MergeWith.
+						count += StructuredPtr::node_count(x->arr_vec[i]);
+					}
+				}
+				StructuredPtr(this).add_node_count(count);
+			}
 			arr_vec.insert((x->arr_vec.begin()) + start_offset,
 				(x->arr_vec.end()));
 		}
@@ -9,7 +9,7 @@ namespace claujson {
 		my_vector<_Value> arr_vec;
 		StructuredPtr parent;
 		bool _is_virtual = false;
-		uint8_t temp[8];
+		uint64_t _node_count = 0; // subtree size (this + values), 0 : not known.
 
 		static _Value data_null; // valid is false..
 		static const uint64_t npos;
@@ -52,6 +52,9 @@ namespace claujson {
 
 		const StructuredPtr get_parent() const;
 
+		// cached number of nodes in this subtree, 0 if not known. only a hint for splitting write work.
+		uint64_t get_node_count() const { return _node_count; }
+
 	public:
 
 		void reserve_data_list(uint64_t len); // if object, reserve key_list and value_list, if array, reserve value_list.
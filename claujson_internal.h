@@ -10,6 +10,23 @@
 #include <fstream>
 #include <cstring>
 #include <cstdint> // uint64_t? int64_t?
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <streambuf>
+#include <algorithm>
+#include <chrono>
+
+// 0 : log << ... is compiled out.
+#ifndef CLAUJSON_LOG
+#define CLAUJSON_LOG 1
+#endif
+
+// 0 : trace is never enabled.
+#ifndef CLAUJSON_TRACE
+#define CLAUJSON_TRACE 1
+#endif
 
 
 template <class From, class To>
@@ -325,11 +342,10 @@ namespace claujson {
 
 	};
 
-	class Log;
-
-	template <class T>
-	static void _print(Log& log, const T& val, const int op);
-
+	// log << info << ... << "\n";
+	//  a line is made in buffer of the thread, then goes to ring buffer of the thread (no lock),
+	//  background thread writes lines to console or file. (Log::flush to write now)
+	//  compiled out if CLAUJSON_LOG is 0. only one Log, claujson::log.
 	class Log {
 	public:
 		class Info {
@@ -355,19 +371,143 @@ namespace claujson {
 			static const int CLEAR = 0;
 		};
 	private:
-		Option opt; // console, file, ...
-		int opt2; // info, warn, ...
-		int state; // 1 : info, 2 : warn. // default is info!
+		// lines of one thread, one producer (the thread), one consumer (flusher).
+		struct Ring {
+			static const uint64_t capacity = 1 << 16;
+			char buf[capacity];
+			std::atomic<uint64_t> head{ 0 };
+			std::atomic<uint64_t> tail{ 0 };
+			std::atomic<bool> closed{ false }; // thread is gone.
+
+			// false if full.
+			bool push(const char* data, uint64_t len) {
+				const uint64_t h = head.load(std::memory_order_relaxed);
+				const uint64_t t = tail.load(std::memory_order_acquire);
+				if (capacity - (h - t) < len) {
+					return false;
+				}
+				const uint64_t pos = h & (capacity - 1);
+				const uint64_t first = std::min(len, capacity - pos);
+				memcpy(buf + pos, data, first);
+				memcpy(buf, data + first, len - first);
+				head.store(h + len, std::memory_order_release);
+				return true;
+			}
+
+			// f(data, len), in one or two parts.
+			template <class F>
+			void pop(F&& f) {
+				const uint64_t t = tail.load(std::memory_order_relaxed);
+				const uint64_t h = head.load(std::memory_order_acquire);
+				if (t == h) {
+					return;
+				}
+				const uint64_t pos = t & (capacity - 1);
+				const uint64_t first = std::min(h - t, capacity - pos);
+				f(buf + pos, first);
+				if (h - t > first) {
+					f(buf, h - t - first);
+				}
+				tail.store(h, std::memory_order_release);
+			}
+		};
+
+		// appends to std::string.
+		class LineBuf : public std::streambuf {
+		public:
+			std::string line;
+		protected:
+			int_type overflow(int_type ch) override {
+				if (ch != traits_type::eof()) {
+					line.push_back(static_cast<char>(ch));
+				}
+				return ch;
+			}
+			std::streamsize xsputn(const char* s, std::streamsize n) override {
+				line.append(s, static_cast<size_t>(n));
+				return n;
+			}
+		};
+
+		// of this thread.
+		struct Local {
+			std::shared_ptr<Ring> ring;
+			LineBuf buf;
+			std::ostream stream{ &buf };
+			bool on = false; // info or warn of now line is printed.
+			bool begun = false; // info or warn is given. (default : info)
+			Log* owner = nullptr; // set by begin.
+
+			~Local() {
+				if (owner && !buf.line.empty()) { // line without '\n'.
+					owner->commit(*this);
+				}
+				if (ring) {
+					ring->closed.store(true);
+				}
+			}
+		};
+		static Local& local() {
+			static thread_local Local x;
+			return x;
+		}
+
+		std::atomic<Option> opt; // console, file, ...
+		std::atomic<int> opt2; // info, warn, ...
 		std::string fileName;
+
+		std::atomic<uint64_t> dropped{ 0 }; // lines, ring was full.
+		std::atomic<uint64_t> pending{ 0 }; // lines pushed since flusher woke up, flusher sleeps while 0.
+
+		std::mutex mutex; // rings, fileName, output.
+		std::vector<std::shared_ptr<Ring>> rings;
+		std::ofstream outFile;
+		std::string outFileName; // of outFile.
+		bool written = false; // output not flushed yet.
+		std::atomic<bool> started{ false };
+		bool stop = false;
+		std::condition_variable condition;
+		std::thread flusher;
+
+		void start();
+		void drain(); // mutex is locked.
+		void flush_written(); // mutex is locked.
+		void output(const char* data, uint64_t len);
+		void commit(Local& me);
 	public:
 
-		Log() : state(0), opt(Option::NO_PRINT), opt2(Option2::CLEAR), fileName("log.txt") {
+		Log() : opt(Option::NO_PRINT), opt2(Option2::CLEAR), fileName("log.txt") {
 			//
 		}
+		~Log();
+
+		Log(const Log&) = delete;
+		Log& operator=(const Log&) = delete;
+
+		bool enabled() const {
+			return opt.load(std::memory_order_relaxed) != Option::NO_PRINT;
+		}
+
+		// new line of info (0) or warn (1).
+		void begin(int state);
 
-	public:
 		template <class T>
-		friend void _print(Log& log, const T& val, const int op);
+		void print(const T& val) {
+			Local& me = local();
+			if (!me.begun) {
+				begin(0);
+			}
+			if (!me.on) {
+				return;
+			}
+			me.stream << val;
+			if (!me.buf.line.empty() && me.buf.line.back() == '\n') {
+				commit(me);
+			}
+		}
+
+		// write lines in ring buffers now, and not ended line of this thread.
+		void flush();
 
 	public:
 
@@ -397,6 +537,7 @@ namespace claujson {
 		}
 
 		void file_name(const std::string& str) {
+			std::unique_lock<std::mutex> lock(mutex);
 			fileName = str;
 		}
 
@@ -405,7 +546,7 @@ namespace claujson {
 				opt2 = Option2::INFO;
 			}
 			else {
-				opt2 = opt2 | Option2::INFO;
+				opt2 |= Option2::INFO;
 			}
 		}
 		void warn(bool only = false) {
@@ -413,69 +554,39 @@ namespace claujson {
 				opt2 = Option2::WARN;
 			}
 			else {
-				opt2 = opt2 | Option2::WARN;
+				opt2 |= Option2::WARN;
 			}
 		}
 	};
 
-	template <class T>
-	static void _print(Log& log, const T& val, const int op) { // op : change_state, with op.
-
-		if (op == 0 || op == 1) {
-			log.state = op;
-		}
-
-		if (log.opt == Log::Option::CONSOLE || log.opt == Log::Option::CONSOLE_AND_FILE) {
-
-			int count = 0;
-
-			if ((log.opt2 & Log::Option2::INFO) && log.state == 0) {
-				count = 1;
-			}
-			if ((log.opt2 & Log::Option2::WARN) && log.state == 1) {
-				count = 1;
-			}
-
-			if (count) {
-				std::cout << val;
-			}
-		}
-
-		if (log.opt == Log::Option::FILE || log.opt == Log::Option::CONSOLE_AND_FILE) {
-			std::ofstream outFile;
-			outFile.open(log.fileName, std::ios::app);
-			if (outFile) {
-				int count = 0;
-
-				if ((log.opt2 & Log::Option2::INFO) && log.state == 0) {
-					count = 1;
-				}
-				if ((log.opt2 & Log::Option2::WARN) && log.state == 1) {
-					count = 1;
-				}
-
-				if (count) {
-					outFile << val;
-				}
-				outFile.close();
-			}
-		}
-	}
-
 	template <class T>
 	inline Log& operator<<(Log& log, const T& val) {
-		_print(log, val, -1);
+#if CLAUJSON_LOG
+		if (log.enabled()) {
+			log.print(val);
+		}
+#endif
 		return log;
 	}
 
 	template<>
 	inline Log& operator<<(Log& log, const Log::Info& x) {
-		_print(log, x, 0);
+#if CLAUJSON_LOG
+		if (log.enabled()) {
+			log.begin(0);
+			log.print(x);
+		}
+#endif
 		return log;
 	}
 	template<>
 	inline Log& operator<<(Log& log, const Log::Warning& x) {
-		_print(log, x, 1);
+#if CLAUJSON_LOG
+		if (log.enabled()) {
+			log.begin(1);
+			log.print(x);
+		}
+#endif
 		return log;
 	}
 
@@ -484,6 +595,105 @@ namespace claujson {
 	extern Log log; // no static..
 	// inline Error error;
 
+	// timeline of pool tasks and phases of parse and write, as chrome trace_event json. (chrome://tracing, ui.perfetto.dev)
+	//  trace.start(); parse or write ...; trace.stop(); trace.write("trace.json");
+	class Trace {
+	public:
+		struct Event {
+			const char* name = nullptr; // string literal.
+			int64_t chunk = -1; // -1 : not a chunk.
+			uint64_t tid = 0; // order of first event of thread.
+			uint64_t begin = 0; // ns, steady_clock.
+			uint64_t end = 0;
+		};
+	private:
+		// events of one thread.
+		struct Buf {
+			std::mutex mutex; // only with events(), start().
+			std::vector<Event> events;
+			uint64_t tid = 0;
+		};
+		static std::shared_ptr<Buf>& local() {
+			static thread_local std::shared_ptr<Buf> x;
+			return x;
+		}
+
+		std::atomic<bool> on{ false };
+		std::mutex mutex; // bufs, origin.
+		std::vector<std::shared_ptr<Buf>> bufs;
+		uint64_t next_tid = 0;
+		uint64_t origin = 0; // ns of start().
+	public:
+		Trace() = default;
+		Trace(const Trace&) = delete;
+		Trace& operator=(const Trace&) = delete;
+
+		bool enabled() const {
+#if CLAUJSON_TRACE
+			return on.load(std::memory_order_relaxed);
+#else
+			return false;
+#endif
+		}
+
+		static uint64_t now() {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// clear events and begin.
+		void start() {
+			std::unique_lock<std::mutex> lock(mutex);
+			for (uint64_t i = 0; i < bufs.size(); ) {
+				if (bufs[i].use_count() == 1) { // thread is gone.
+					bufs.erase(bufs.begin() + i);
+					continue;
+				}
+				std::unique_lock<std::mutex> lock2(bufs[i]->mutex);
+				bufs[i]->events.clear();
+				++i;
+			}
+			origin = now();
+			on = true;
+		}
+		void stop() {
+			on = false;
+		}
+
+		void add(const char* name, int64_t chunk, uint64_t begin, uint64_t end) {
+			std::shared_ptr<Buf>& me = local();
+			if (!me) {
+				me = std::make_shared<Buf>();
+				std::unique_lock<std::mutex> lock(mutex);
+				me->tid = next_tid++;
+				bufs.push_back(me);
+			}
+			std::unique_lock<std::mutex> lock(me->mutex);
+			me->events.push_back(Event{ name, chunk, me->tid, begin, end });
+		}
+
+		// events of all threads, by begin.
+		std::vector<Event> events() {
+			std::vector<Event> result;
+			std::unique_lock<std::mutex> lock(mutex);
+			for (auto& x : bufs) {
+				std::unique_lock<std::mutex> lock2(x->mutex);
+				result.insert(result.end(), x->events.begin(), x->events.end());
+			}
+			std::sort(result.begin(), result.end(), [](const Event& a, const Event& b) { return a.begin < b.begin; });
+			return result;
+		}
+
+		uint64_t start_time() {
+			std::unique_lock<std::mutex> lock(mutex);
+			return origin;
+		}
+
+		// chrome trace_event json. (by claujson::writer)
+		bool write(const std::string& fileName);
+	};
+
+	extern Trace trace;
+
 	template <class T>
 	using PtrWeak = T*;
 
@@ -560,11 +770,14 @@ namespace claujson {
 			Block& operator=(const Block&) = delete;
 		};
 	public:
-		Block* head[4];
-		Block* rear[4];
+		// 0 : generic, 1 : 16, 2 : 32, 3 : 64, 4 : string heap (lazy, only used if use_str_heap)
+		Block* head[5];
+		Block* rear[5];
 		uint64_t defaultBlockSize;
 		Arena* now_pool;
 		Arena* next;
+		bool use_str_heap = false;
+		bool lazy_number = false; // keep number text in heap, see _Value::is_lazy_number.
 	public:
 		Arena(uint64_t initialSize = 1024 * 512 + 64)
 			: defaultBlockSize(initialSize) {
@@ -572,6 +785,8 @@ namespace claujson {
 				head[i] = (new (std::nothrow) Block(initialSize));
 				rear[i] = head[i];
 			}
+			head[4] = nullptr;
+			rear[4] = nullptr;
 			now_pool = this;
 			next = nullptr;
 		}
@@ -579,7 +794,7 @@ namespace claujson {
 		Arena(const Arena&) = delete;
 		Arena& operator=(const Arena&) = delete;
 
-		static int64_t counter;
+		static std::atomic<int64_t> counter; // arenas of chunks are filled at the same time.
 	private:
 		
 		// _Value
@@ -1008,6 +1223,51 @@ namespace claujson {
 			}
 		}
 
+		// string bytes, if use_str_heap then appended to contiguous string heap, no align.
+		char* allocate_str(uint64_t size) {
+			if (!now_pool->use_str_heap) {
+				return allocate<char>(size);
+			}
+			return allocate_heap(size);
+		}
+
+		// append to string heap.
+		char* allocate_heap(uint64_t size) {
+			Block* block = now_pool->head[4];
+			if (block && block->offset + size <= block->capacity) {
+				char* ptr = reinterpret_cast<char*>(block->data + block->offset);
+				block->offset += size;
+				return ptr;
+			}
+
+			// allocate new block
+			uint64_t newCap = std::max(defaultBlockSize, size);
+			Block* newBlock = new (std::nothrow) Block(newCap);
+			if (!newBlock || !newBlock->data) {
+				delete newBlock;
+				return nullptr;
+			}
+			counter++;
+
+			newBlock->next = now_pool->head[4];
+			now_pool->head[4] = newBlock;
+			if (!now_pool->rear[4]) {
+				now_pool->rear[4] = newBlock;
+			}
+
+			newBlock->offset = size;
+			return reinterpret_cast<char*>(newBlock->data);
+		}
+
+		// used bytes of string heap.
+		uint64_t str_heap_size() const {
+			uint64_t sum = 0;
+			for (Block* block = head[4]; block; block = block->next) {
+				sum += block->offset;
+			}
+			return sum;
+		}
+
 		template<typename T, typename... Args>
 		T* create(Args&&... args) {
 			void* mem = allocate<T>(sizeof(T), alignof(T));
@@ -1017,7 +1277,7 @@ namespace claujson {
 	public:
 		~Arena() {
 			//return;
-			for (int i = 0; i < 4; ++i) {
+			for (int i = 0; i < 5; ++i) {
 				if (head[i]) {
 					Block* block = head[i];
 					while (block) {
@@ -1038,7 +1298,10 @@ namespace claujson {
 
 		// chk! when merge?
 		void link_from(Arena* other) {
-			for (int i = 0; i < 4; ++i) {
+			for (int i = 0; i < 5; ++i) {
+				if (!other->head[i]) {
+					continue;
+				}
 				if (!this->head[i]) {
 					this->head[i] = other->head[i];
 					this->rear[i] = other->rear[i];
@@ -6,20 +6,6 @@ namespace claujson {
 	_Value Object::data_null{ nullptr, false }; // valid is false..
 	const uint64_t Object::npos = -1; // 
 
-	class CompKey {
-	private:
-		const my_vector<Pair<_Value, _Value>>* vec;
-	public:
-
-		CompKey(const my_vector<Pair<_Value, _Value>>* vec) : vec(vec) {
-			//
-		}
-
-		bool operator()(uint64_t x, uint64_t y) const {
-			return (*vec)[x].first < (*vec)[y].first;
-		}
-	};
-
 	_Value Object::clone(Arena* pool) const {
 		_Value result = Object::Make(pool);
 
@@ -33,33 +19,58 @@ namespace claujson {
 			result.as_object()->add_element(this->get_key_list(i).clone(pool),
 													std::move(x));
 		}
+		result.as_object()->_node_count = _node_count;
 
 		return result;
 	}
 
 	bool Object::chk_key_dup(uint64_t* idx) const {
-		bool has_dup = false;
-		my_vector<uint64_t> copy_(obj_data.size());
+		const uint64_t len = obj_data.size();
 
-		for (uint64_t i = 0; i < copy_.size(); ++i) {
-			copy_[i] = i;
+		// small object : linear check.
+		if (len <= 16) {
+			for (uint64_t i = 1; i < len; ++i) {
+				if (!obj_data[i].first.is_str()) {
+					continue;
+				}
+				for (uint64_t j = 0; j < i; ++j) {
+					if (obj_data[i].first == obj_data[j].first) {
+						if (idx) {
+							*idx = j; //
+						}
+						return true;
+					}
+				}
+			}
+			return false;
 		}
 
-		CompKey comp(&obj_data);
-
-		std::stable_sort(copy_.begin(), copy_.end(), comp);
+		// large object : open addressing with cached key hash, slot has (key index + 1).
+		uint64_t cap = 32;
+		while (cap < len * 2) {
+			cap <<= 1;
+		}
+		std::vector<uint64_t> table(cap, 0);
 
-		for (uint64_t i = 1; i < copy_.size(); ++i) {
-			if (obj_data[copy_[i]].first == obj_data[copy_[i - 1]].first) {
-				has_dup = true;
-				if (idx) {
-					*idx = copy_[i - 1]; //
+		for (uint64_t i = 0; i < len; ++i) {
+			const _Value& key = obj_data[i].first;
+			if (!key.is_str()) {
+				continue;
+			}
+			uint64_t slot = key.get_string().hash() & (cap - 1);
+			while (table[slot] != 0) {
+				if (obj_data[table[slot] - 1].first == key) {
+					if (idx) {
+						*idx = table[slot] - 1; //
+					}
+					return true;
 				}
-				break;
+				slot = (slot + 1) & (cap - 1);
 			}
+			table[slot] = i + 1;
 		}
 
-		return has_dup;
+		return false;
 	}
 
 	_Value Object::Make(Arena* pool) {
@@ -139,8 +150,10 @@ namespace claujson {
 	}
 
 	void Object::clear(uint64_t idx) {
+		StructuredPtr(this).sub_node_count(obj_data[idx].second);
 		obj_data[idx].second.clear(false);
 		obj_data[idx].first.clear(false);
+		StructuredPtr(this).add_node_count(obj_data[idx].second);
 	}
 
 	bool Object::is_virtual() const {
@@ -148,6 +161,9 @@ namespace claujson {
 	}
 
 	void Object::clear() {
+		if (_node_count != 0) {
+			StructuredPtr(this).add_node_count(1 - static_cast<int64_t>(_node_count));
+		}
 		obj_data.clear();
 	}
 
@@ -266,6 +282,7 @@ namespace claujson {
 				Object* x = val.Get().as_object();
 				x->set_parent(this);
 			}
+			StructuredPtr(this).add_node_count(val.Get());
 			obj_data.push_back({ std::move(key.Get()), std::move(val.Get()) });
 			return true;
 		}
@@ -284,12 +301,17 @@ namespace claujson {
 				x->set_parent(this);
 			}
 		}
+		StructuredPtr(this).add_node_count(val.Get());
 		obj_data.push_back({ std::move(key.Get()), std::move(val.Get()) });
 
 		return true;
 	}
 
-	bool Object::assign_value_element(uint64_t idx, Value val) { this->obj_data[idx].second = std::move(val.Get()); return true; }
+	bool Object::assign_value_element(uint64_t idx, Value val) {
+		StructuredPtr(this).sub_node_count(obj_data[idx].second);
+		StructuredPtr(this).add_node_count(val.Get());
+		this->obj_data[idx].second = std::move(val.Get()); return true;
+	}
 	//bool Object::assign_key_element(uint64_t idx, Value key) {
 	//	if (!key.Get() || !key.Get().is_str()) {
 	//		return false;
@@ -304,6 +326,7 @@ namespace claujson {
 	}
 
 	void Object::erase(uint64_t idx, bool real) {
+		StructuredPtr(this).sub_node_count(obj_data[idx].second);
 
 		if (real) {
 			clean(obj_data[idx].first);
@@ -336,6 +359,15 @@ namespace claujson {
 		}
 
 		if (x->obj_data.empty() == false) {
+			if (_node_count != 0) {
+				int64_t count = 0;
+				for (uint64_t i = start_offset; i < x->obj_data.size(); ++i) {
+					if (!x->obj_data[i].second.is_virtual()) { // merged by its own MergeWith.
+						count += StructuredPtr::node_count(x->obj_data[i].second);
+					}
+				}
+				StructuredPtr(this).add_node_count(count);
+			}
 			obj_data.insert((x->obj_data.begin()) + start_offset,
 				(x->obj_data.end()));
 		}
@@ -344,7 +376,6 @@ namespace claujson {
 		}
 	}
 	void Object::MergeWith(PartialJson* j, int start_offset) {
-
 		auto* x = j;
 
 		if (x->arr_vec.empty() == false) { // not object?
@@ -368,6 +399,15 @@ namespace claujson {
 		}
 
 		if (x->obj_data.empty() == false) {
+			if (_node_count != 0) {
+				int64_t count = 0;
+				for (uint64_t i = start_offset; i < x->obj_data.size(); ++i) {
+					if (!x->obj_data[i].second.is_virtual()) { // merged by its own MergeWith.
+						count += StructuredPtr::node_count(x->obj_data[i].second);
+					}
+				}
+				StructuredPtr(this).add_node_count(count);
+			}
 			obj_data.insert(x->obj_data.begin() + start_offset,
 				(x->obj_data.end()));
 		}
@@ -7,7 +7,7 @@ namespace claujson {
 		my_vector<Pair<claujson::_Value, claujson::_Value>> obj_data;
 		StructuredPtr parent;
 		bool _is_virtual = false;
-		uint8_t temp[8];
+		uint64_t _node_count = 0; // subtree size (this + values, not keys), 0 : not known.
 	public:
 		static _Value data_null; // valid is false..
 		static const uint64_t npos;
@@ -38,6 +38,9 @@ namespace claujson {
 
 		const StructuredPtr get_parent() const;
 
+		// cached number of nodes in this subtree, 0 if not known. only a hint for splitting write work.
+		uint64_t get_node_count() const { return _node_count; }
+
 	public:
 		bool change_key(const _Value& key, Value new_key);
 		bool change_key(uint64_t idx, Value new_key);
@@ -22,9 +22,21 @@ namespace claujson {
 			};
 		};
 		Arena* pool = nullptr;
-		uint8_t temp[8];
+		uint32_t _hash = 0; // 0 : not computed yet.
+		uint8_t _escape = 0; // 0 : not known, 1 : no char to escape, 2 : has char to escape.
+		uint8_t temp[3];
 	public:
 		static const uint64_t npos = -1;
+
+		// FNV-1a, 0 is reserved for `not computed`.
+		static uint32_t compute_hash(const char* x, uint64_t len) {
+			uint32_t h = 2166136261u;
+			for (uint64_t i = 0; i < len; ++i) {
+				h ^= static_cast<uint8_t>(x[i]);
+				h *= 16777619u;
+			}
+			return h == 0 ? 1 : h;
+		}
 	public:
 		String& operator=(const String& other) = delete;
 
@@ -35,6 +47,8 @@ namespace claujson {
 			std::swap(this->sz, other.sz);
 			std::swap(this->type, other.type);
 			std::swap(this->pool, other.pool);
+			std::swap(this->_hash, other._hash);
+			std::swap(this->_escape, other._escape);
 		}
 
 	public:
@@ -65,7 +79,7 @@ namespace claujson {
 			if (this->type == _ValueType::STRING) {
 				obj.sz = this->sz;
 				if (pool) {
-					obj.str = (char*)pool->allocate<char>(sizeof(char) * (this->sz + 1));
+					obj.str = pool->allocate_str(sizeof(char) * (this->sz + 1));
 				}
 				else {
 					obj.str = new (std::nothrow) char[this->sz + 1];
@@ -86,6 +100,8 @@ namespace claujson {
 			}
 
 			obj.type = this->type;
+			obj._hash = this->_hash;
+			obj._escape = this->_escape;
 
 			return obj;
 		}
@@ -96,6 +112,8 @@ namespace claujson {
 			std::swap(this->sz, other.sz);
 			std::swap(this->type, other.type);
 			std::swap(this->pool, other.pool); // check!
+			std::swap(this->_hash, other._hash);
+			std::swap(this->_escape, other._escape);
 			return *this;
 		}
 
@@ -112,7 +130,7 @@ namespace claujson {
 			}
 			else {
 				if (pool) {
-					this->str = (char*)pool->allocate<char>(sizeof(char)*(this->sz + 1));
+					this->str = pool->allocate_str(sizeof(char)*(this->sz + 1));
 				}
 				else {
 					this->str = new (std::nothrow) char[this->sz + 1];
@@ -145,7 +163,7 @@ namespace claujson {
 			//	this->type = _ValueType::SHORT_STRING;
 			//	return;
 				if (pool) {
-					this->str = (char*)pool->allocate<char>(sizeof(char) * (this->sz + 1));
+					this->str = pool->allocate_str(sizeof(char) * (this->sz + 1));
 				}
 				else {
 					this->str = new (std::nothrow) char[this->sz + 1];
@@ -218,6 +236,32 @@ namespace claujson {
 			sz = 0;
 			str = nullptr;
 			type = _ValueType::NONE;
+			_hash = 0;
+			_escape = 0;
+		}
+
+		// computed if not set, const calls do not write. (threads can read the same document)
+		uint32_t hash() const {
+			return _hash != 0 ? _hash : compute_hash(data(), size());
+		}
+
+		// set at parse (keys) and set_str.
+		void update_hash() {
+			_hash = compute_hash(data(), size());
+		}
+
+		bool has_hash() const {
+			return _hash != 0;
+		}
+
+		// set at parse and set_str, writer copies string without escape scan if 1.
+		//  (like hash, not updated if chars are changed by data())
+		uint8_t escape_info() const {
+			return _escape;
+		}
+
+		void set_escape_info(bool has_escape_char) {
+			_escape = has_escape_char ? 2 : 1;
 		}
 
 		bool operator<(const String& other) const {
@@ -233,9 +277,13 @@ namespace claujson {
 			return StringView(data(), size()) == other;
 		}
 
+		// length first, then cached hash (only if both have it), then bytes.
 		bool operator==(const String& other) const {
 			if (!this->is_valid() || !other.is_valid()) { return false; }
-			return StringView(data(), size()) == StringView(other.data(), other.size());
+			const uint64_t len = size();
+			if (len != other.size()) { return false; }
+			if (this->_hash != 0 && other._hash != 0 && this->_hash != other._hash) { return false; }
+			return len == 0 || memcmp(data(), other.data(), len) == 0;
 		}
 
 		std::string get_std_string(bool& fail) const {
@@ -276,7 +324,7 @@ namespace claujson {
 				char* temp = nullptr;
 
 				if (pool) {
-					temp = (char*)pool->allocate<char>(sizeof(char) * (str.size() + 1));
+					temp = pool->allocate_str(sizeof(char) * (str.size() + 1));
 				}
 				else {
 					temp = new (std::nothrow) char[str.size()];
@@ -14,6 +14,11 @@ namespace claujson {
 
 		if (this->is_str()) {
 			x.set_str_in_parse(pool, this->_str_val->data(), this->_str_val->size());
+			x._str_val->_hash = this->_str_val->_hash;
+			x._str_val->_escape = this->_str_val->_escape;
+		}
+		else if (this->is_lazy_number()) { // x can be in other pool.
+			x._uint_val = this->decode_lazy_number();
 		}
 		else {
 			x._int_val = this->_int_val;
@@ -34,21 +39,25 @@ namespace claujson {
 
 	_Value::_Value(Array* x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::ARRAY;
 		this->_array_ptr = (x);
 	}
 	_Value::_Value(Object* x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::OBJECT;
 		this->_obj_ptr = (x);
 	}
 	_Value::_Value(PartialJson* x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::PARTIAL_JSON;
 		this->_pj_ptr = (x);
 	}
 	_Value::_Value(StructuredPtr x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		if (x.is_array()) {
 			this->_type = _ValueType::ARRAY;
 			this->_array_ptr = x.arr;
@@ -68,33 +77,39 @@ namespace claujson {
 
 	_Value::_Value(int x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		set_int(x);
 	}
 
 	_Value::_Value(unsigned int x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		set_uint(x);
 	}
 
 	_Value::_Value(int64_t x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		set_int(x);
 	}
 	_Value::_Value(uint64_t x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		set_uint(x);
 	}
 	_Value::_Value(double x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		set_float(x);
 	}
 	_Value::_Value(Arena* pool, StringView x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 
 		if (!set_str(pool, x.data(), x.size())) {
@@ -106,6 +121,7 @@ namespace claujson {
 	// C++20~
 	_Value::_Value(Arena* pool, std::u8string_view x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		if (!set_str(pool, reinterpret_cast<const char*>(x.data()), x.size())) {
 			set_type(_ValueType::NOT_VALID);
@@ -115,6 +131,7 @@ namespace claujson {
 	_Value::_Value(Arena* pool, const char8_t* x) {
 		std::u8string_view sv(x);
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		if (!set_str(pool, reinterpret_cast<const char*>(sv.data()), sv.size())) {
 			set_type(_ValueType::NOT_VALID);
@@ -125,6 +142,7 @@ namespace claujson {
 
 	_Value::_Value(Arena* pool, const char* x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		if (!set_str(pool, x, strlen(x))) {
 			set_type(_ValueType::NOT_VALID);
@@ -133,17 +151,20 @@ namespace claujson {
 
 	_Value::_Value(bool x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		set_bool(x);
 	}
 	_Value::_Value(std::nullptr_t x) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		set_type(_ValueType::NULL_);
 	}
 
 	_Value::_Value(std::nullptr_t, bool valid) {
 		this->_int_val = 0;
+		this->temp = 0;
 		this->_type = _ValueType::NONE;
 		set_type(_ValueType::NULL_);
 		if (!valid) {
@@ -204,29 +225,89 @@ namespace claujson {
 	}
 
 	int64_t _Value::int_val() const {
+		if (is_lazy_number()) {
+			return static_cast<int64_t>(decode_lazy_number());
+		}
 		return _int_val;
 	}
 
 	uint64_t _Value::uint_val() const {
+		if (is_lazy_number()) {
+			return decode_lazy_number();
+		}
 		return _uint_val;
 	}
 
 	double _Value::float_val() const {
+		if (is_lazy_number()) {
+			uint64_t x = decode_lazy_number();
+			double result;
+			memcpy(&result, &x, sizeof(double));
+			return result;
+		}
 		return _float_val;
 	}
 
 	int64_t& _Value::int_val() {
+		materialize_number();
 		return _int_val;
 	}
 
 	uint64_t& _Value::uint_val() {
+		materialize_number();
 		return _uint_val;
 	}
 
 	double& _Value::float_val() {
+		materialize_number();
 		return _float_val;
 	}
 
+	void _Value::set_lazy_number_in_parse(const char* str, uint32_t len, _ValueType type) {
+		_num_str = str;
+		temp = len;
+		_type = type;
+	}
+
+	// returns bits of int64 or double.
+	uint64_t _Value::decode_lazy_number() const {
+		const char* str = _num_str;
+		const uint32_t len = temp;
+
+		if (_type != _ValueType::FLOAT) { // at most 18 digits, no overflow.
+			uint32_t i = 0;
+			bool neg = false;
+			if (str[0] == '-') {
+				neg = true;
+				++i;
+			}
+			int64_t x = 0;
+			for (; i < len; ++i) {
+				x = x * 10 + (str[i] - '0');
+			}
+			return static_cast<uint64_t>(neg ? -x : x);
+		}
+
+		// parse_number needs padding.
+		uint8_t buf[64 + _simdjson::_SIMDJSON_PADDING];
+		uint64_t temp[2] = { 0 };
+		memcpy(buf, str, len);
+		memset(buf + len, ' ', sizeof(buf) - len);
+
+		if (_simdjson::parse_number(buf, temp) != _simdjson::SUCCESS) {
+			log << warn << "parse number error in lazy number\n";
+			return 0;
+		}
+		return temp[1];
+	}
+
+	void _Value::materialize_number() {
+		if (is_lazy_number()) {
+			_uint_val = decode_lazy_number();
+			temp = 0;
+		}
+	}
+
 	bool _Value::bool_val() const {
 		if (!is_bool()) {
 			return false;
@@ -378,6 +459,7 @@ namespace claujson {
 			}
 		}
 		_int_val = x;
+		temp = 0;
 		_type = _ValueType::INT;
 	}
 
@@ -395,6 +477,7 @@ namespace claujson {
 			}
 		}
 		_uint_val = x;
+		temp = 0;
 		_type = _ValueType::UINT;
 	}
 
@@ -412,6 +495,7 @@ namespace claujson {
 			}
 		}
 		_float_val = x;
+		temp = 0;
 
 		_type = _ValueType::FLOAT;
 	}
@@ -530,6 +614,8 @@ namespace claujson {
 			}
 		}
 
+		_str_val->update_hash();
+		_str_val->set_escape_info(has_escape_char(StringView(_str_val->data(), _str_val->size())));
 		_type = _ValueType::STRING;
 
 		return true;
@@ -633,7 +719,7 @@ namespace claujson {
 	}
 
 	_Value::_Value(_Value&& other) noexcept
-		: _type(_ValueType::NONE)
+		: temp(0), _type(_ValueType::NONE)
 	{
 		if (!other.is_valid()) {
 			return;
@@ -641,11 +727,12 @@ namespace claujson {
 
 		{
 			std::swap(_int_val, other._int_val);
+			std::swap(this->temp, other.temp);
 			std::swap(this->_type, other._type);
 		}
 	}
 
-	_Value::_Value() : _int_val(0), _type(_ValueType::NONE) {}
+	_Value::_Value() : _int_val(0), temp(0), _type(_ValueType::NONE) {}
 
 	bool _Value::operator==(const _Value& other) const { // chk array or object?
 		if (this->_type == other._type) {
@@ -655,13 +742,13 @@ namespace claujson {
 				return *this->_str_val == *other._str_val;
 				break;
 			case _ValueType::INT:
-				return this->_int_val == other._int_val;
+				return this->int_val() == other.int_val();
 				break;
 			case _ValueType::UINT:
-				return this->_uint_val == other._uint_val;
+				return this->uint_val() == other.uint_val();
 				break;
 			case _ValueType::FLOAT:
-				return this->_float_val == other._float_val;
+				return this->float_val() == other.float_val();
 				break;
 			case _ValueType::BOOL:
 				return this->_bool_val == other._bool_val;
@@ -732,13 +819,13 @@ namespace claujson {
 				return *this->_str_val < *other._str_val;
 				break;
 			case _ValueType::INT:
-				return this->_int_val < other._int_val;
+				return this->int_val() < other.int_val();
 				break;
 			case _ValueType::UINT:
-				return this->_uint_val < other._uint_val;
+				return this->uint_val() < other.uint_val();
 				break;
 			case _ValueType::FLOAT:
-				return this->_float_val < other._float_val;
+				return this->float_val() < other.float_val();
 				break;
 			case _ValueType::BOOL:
 				return this->_bool_val < other._bool_val;
@@ -18,6 +18,10 @@
 #include "_simdjson.h"
 
 #include <cstring>
+#include <thread>
+#if defined(__linux__)
+#include <pthread.h>
+#endif
 
 // using namespace std::literals::u8string_view_literals; // ?? 
 
@@ -80,6 +84,308 @@ void str_test() {
 	
 }
 
+// coordinates-only synthetic file, [[x,y],[x,y],...]
+std::string coordinates_json(int n) {
+	std::string json;
+	json.reserve(n * 25);
+	json += "[";
+	uint64_t seed = 12345;
+	for (int i = 0; i < n; ++i) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		double x = (double)((seed >> 11) % 360000000) / 1000000 - 180;
+		double y = (double)((seed >> 40) % 18000000) / 100000 - 90;
+		char temp[64];
+		snprintf(temp, sizeof(temp), "%s[%.6f,%.5f]", i > 0 ? "," : "", x, y);
+		json += temp;
+	}
+	json += "]";
+	return json;
+}
+
+// -> parse time.
+void coordinates_bench(int thr_num) {
+	const std::string json = coordinates_json(4000000);
+
+	claujson::parser p;
+
+	for (int i = 0; i < 3; ++i) {
+		claujson::Document d;
+		auto a = std::chrono::steady_clock::now();
+		auto x = p.parse_str(json, d, thr_num);
+		auto b = std::chrono::steady_clock::now();
+		auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+		std::cout << "coordinates " << json.size() / (1024 * 1024) << "MB " << x.first << " " << dur.count() << "ms\n";
+	}
+
+	// number formatting in writer.
+	{
+		claujson::Document d;
+		p.parse_str(json, d, thr_num);
+
+		claujson::writer w;
+		for (int i = 0; i < 3; ++i) {
+			auto a = std::chrono::steady_clock::now();
+			std::string out = w.write_to_str(d.Get());
+			auto b = std::chrono::steady_clock::now();
+			auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+			std::cout << "write coordinates " << out.size() / (1024 * 1024) << "MB " << dur.count() << "ms"
+				<< " estimate " << w.get_stats().estimated_size / (1024 * 1024) << "MB grow " << w.get_stats().buffer_grow_count << "\n";
+		}
+	}
+}
+
+#if defined(__linux__)
+static bool pin_this_thread(int cpu) {
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+#endif
+
+// cross-socket effect : memory filled on first node, read from first and last node.
+//  then parse + write_parallel3 with SchedulerOption::numa off and on.
+//  not measured on a multi-socket host yet, with one node only the numa off run is done.
+void numa_bench(int thr_num) {
+	const auto cpus = claujson::numa_cpus();
+	std::cout << "numa nodes " << cpus.size() << "\n";
+
+#if defined(__linux__)
+	if (cpus.size() >= 2) {
+		const uint64_t n = (uint64_t(1) << 28) / sizeof(uint64_t); // 256MB
+		std::vector<uint64_t> buf;
+		bool pinned = true;
+
+		std::thread([&] {
+			pinned = pin_this_thread(cpus.front()[0]);
+			buf.resize(n, 1); // first touch.
+		}).join();
+
+		for (const auto* node : { &cpus.front(), &cpus.back() }) {
+			if (!pinned) {
+				std::cout << "pinning is not available, local / remote read skipped\n";
+				break;
+			}
+			std::thread([&] {
+				pinned = pin_this_thread((*node)[0]);
+				if (!pinned) {
+					return;
+				}
+				for (int k = 0; k < 3; ++k) {
+					auto a = std::chrono::steady_clock::now();
+					uint64_t sum = 0;
+					for (uint64_t i = 0; i < n; ++i) {
+						sum += buf[i];
+					}
+					auto b = std::chrono::steady_clock::now();
+					auto dur = std::chrono::duration_cast<std::chrono::milliseconds>(b - a);
+					std::cout << (node == &cpus.front() ? "local" : "remote") << " read 256MB " << dur.count() << "ms " << sum << "\n";
+				}
+			}).join();
+		}
+	}
+#endif
+
+	const std::string json = coordinates_json(8000000);
+
+	for (bool numa : { false, true }) {
+		if (numa && cpus.size() < 2) {
+			std::cout << "numa 1 skipped : less than 2 NUMA nodes\n";
+			break;
+		}
+		claujson::SchedulerOption option;
+		option.numa = numa;
+		if (!claujson::set_scheduler_option(option)) {
+			std::cout << "numa " << numa << " skipped : scheduler option not set, shared pool is in use\n";
+			continue;
+		}
+
+		claujson::parser p;
+		claujson::writer w;
+		for (int i = 0; i < 3; ++i) {
+			claujson::Document d;
+			auto a = std::chrono::steady_clock::now();
+			p.parse_str(json, d, thr_num);
+			auto b = std::chrono::steady_clock::now();
+
+			std::string out;
+			claujson::BufferSink sink(out);
+			w.write_parallel3(sink, d.Get(), thr_num);
+			auto c = std::chrono::steady_clock::now();
+
+			std::cout << "numa " << numa << " parse " << std::chrono::duration_cast<std::chrono::milliseconds>(b - a).count() << "ms"
+				<< " write " << std::chrono::duration_cast<std::chrono::milliseconds>(c - b).count() << "ms " << out.size() / (1024 * 1024) << "MB\n";
+		}
+	}
+}
+
+// for ParseOption::chunk_min_tokens, chunk_min_bytes : parse time in one thread vs in chunks of thr_num (>= 2) threads,
+//  by number of tokens and bytes.
+void small_bench(int thr_num) {
+	for (int n = 8; n <= (1 << 16); n *= 4) {
+		const std::string json = coordinates_json(n); // 6 tokens per point.
+		const int repeat = std::max(1, (1 << 20) / n);
+
+		std::cout << "tokens " << 6 * n << " bytes " << json.size();
+		for (int small : { 1, 0 }) {
+			claujson::parser p;
+			claujson::ParseOption option;
+			option.chunk_min_tokens = small ? (uint64_t)-1 : 0;
+			option.chunk_min_bytes = small ? (uint64_t)-1 : 0;
+			p.set_option(option);
+
+			auto a = std::chrono::steady_clock::now();
+			for (int i = 0; i < repeat; ++i) {
+				claujson::Document d;
+				p.parse_str(json, d, thr_num);
+			}
+			auto b = std::chrono::steady_clock::now();
+			auto dur = std::chrono::duration_cast<std::chrono::nanoseconds>(b - a);
+			std::cout << (small ? " one thread " : " chunks ") << dur.count() / repeat / 1000 << "us";
+		}
+		std::cout << "\n";
+	}
+}
+
+// many small documents : one parser in a loop vs parse_str_batch.
+void batch_bench(int thr_num) {
+	std::vector<std::string> json;
+	for (int i = 0; i < 4000; ++i) {
+		json.push_back(coordinates_json(50 + i % 100));
+	}
+	std::vector<claujson::StringView> strs(json.begin(), json.end());
+
+	claujson::parser p;
+	for (int i = 0; i < 3; ++i) {
+		auto a = std::chrono::steady_clock::now();
+		for (auto& x : json) {
+			claujson::Document d;
+			p.parse_str(x, d, thr_num);
+		}
+		auto b = std::chrono::steady_clock::now();
+		auto docs = p.parse_str_batch(strs, thr_num);
+		auto c = std::chrono::steady_clock::now();
+
+		std::cout << "batch " << json.size() << " documents, loop " << std::chrono::duration_cast<std::chrono::milliseconds>(b - a).count() << "ms"
+			<< " parse_str_batch " << std::chrono::duration_cast<std::chrono::milliseconds>(c - b).count() << "ms\n";
+	}
+}
+
+// parse_async : caller polls progress while the pool parses.
+void async_bench(int thr_num) {
+	const std::string json = coordinates_json(8000000);
+
+	claujson::parser p;
+	claujson::Document d;
+	auto a = std::chrono::steady_clock::now();
+	auto result = p.parse_str_async(json, d, thr_num);
+	while (!result.is_ready()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		std::cout << "progress " << result.control().done_bytes() << " / " << result.control().total_bytes() << "\n";
+	}
+	auto x = result.get();
+	auto b = std::chrono::steady_clock::now();
+	std::cout << "parse_async " << x.first << " " << std::chrono::duration_cast<std::chrono::milliseconds>(b - a).count() << "ms\n";
+}
+
+void print_counters(const char* phase, const claujson::PerfCounters& x) {
+	std::cout << phase << " cycles " << x.cycles << " instructions " << x.instructions << " llc_misses " << x.llc_misses
+		<< " branch_misses " << x.branch_misses << " dtlb_misses " << x.dtlb_misses << "\n";
+}
+
+// ParseOption::stats, WriteStats : time of each phase, chunks, threads.
+void stats_bench(int thr_num) {
+	const std::string json = coordinates_json(8000000);
+
+	claujson::parser p;
+	claujson::ParseOption option;
+	option.stats = true;
+	option.perf_counters = true;
+	p.set_option(option);
+
+	claujson::Document d;
+	p.parse_str(json, d, thr_num);
+
+	const claujson::ParseStats& s = p.get_stats();
+	std::cout << "parse " << s.total_ns / 1000000 << "ms stage1 " << s.stage1_ns / 1000000 << "ms partition " << s.partition_ns / 1000
+		<< "us validate " << s.validate_ns / 1000000 << "ms build " << s.build_ns / 1000000 << "ms merge " << s.merge_ns / 1000
+		<< "us link " << s.link_ns / 1000 << "us finish " << s.finish_ns / 1000000 << "ms\n";
+	std::cout << "threads " << s.threads << " utilization " << s.utilization << " arenas " << s.arenas << " blocks " << s.arena_blocks << "\n";
+	for (auto& x : s.build_chunks) {
+		std::cout << " chunk tokens " << x.tokens << " bytes " << x.bytes << " " << x.ns / 1000 << "us worker " << x.worker << "\n";
+	}
+	if (s.perf_counters) {
+		print_counters("stage1", s.stage1_counters);
+		print_counters("validate", s.validate_counters);
+		print_counters("build", s.build_counters);
+		print_counters("merge", s.merge_counters);
+	}
+
+	claujson::writer w;
+	w.set_perf_counters(true);
+	w.write_parallel3("output.json", d.Get(), thr_num, false);
+
+	const claujson::WriteStats& ws = w.get_stats();
+	std::cout << "write " << ws.total_ns / 1000000 << "ms split " << ws.split_ns / 1000 << "us presize " << ws.presize_ns / 1000000
+		<< "ms write " << ws.write_ns / 1000000 << "ms output " << ws.output_ns / 1000000 << "ms threads " << ws.threads
+		<< " utilization " << ws.utilization << " chunks " << ws.chunks.size() << "\n";
+	if (ws.perf_counters) {
+		print_counters("write", ws.write_counters);
+	}
+	else {
+		std::cout << "no hardware counters\n";
+	}
+}
+
+// timeline of parse and write -> trace.json, open in chrome://tracing or ui.perfetto.dev
+void trace_bench(int thr_num) {
+	const std::string json = coordinates_json(8000000);
+
+	claujson::trace.start();
+	{
+		claujson::parser p;
+		claujson::Document d;
+		p.parse_str(json, d, thr_num);
+
+		claujson::writer w;
+		w.write_parallel3("output.json", d.Get(), thr_num, false);
+	}
+	claujson::trace.stop();
+
+	std::cout << "trace " << claujson::trace.events().size() << " events " << claujson::trace.write("trace.json") << "\n";
+}
+
+// reformat vs parse + write, returns count of fails.
+//  bad : reformat must reject. good : reformat output must be valid json, same as input after parse + write.
+int reformat_test(int thr_num) {
+	const char* bad[] = { "[[]", "tru", "-", "[-]", "[.5]", "[1]]", "[01]", "[1.]", "[+1]", "[1e]",
+		"{\"a\\x\":1}", "[\"\\q\"]", "[\"a\\u12\"]", "[\"\\ud800\"]" };
+	const char* good[] = { "[1,-0,0.25,1.5e3,-2E-2]", "{\"k\":[true,false,null]}", "[\"\\u0041\\n\\ud83d\\ude00\"]", " [ 1 , \"a b\" ] ", "0" };
+
+	claujson::parser p;
+	claujson::writer w;
+	int fail = 0;
+
+	for (const char* x : bad) {
+		std::string out;
+		if (p.reformat_str(x, out, false, thr_num)) {
+			std::cout << "accepted " << x << " -> " << out << "\n";
+			++fail;
+		}
+	}
+	for (const char* x : good) {
+		std::string out;
+		claujson::Document a, b;
+		if (!p.reformat_str(x, out, false, thr_num) || !p.parse_str(x, a, thr_num).first || !p.parse_str(out, b, thr_num).first
+			|| w.write_to_str(a.Get()) != w.write_to_str(b.Get())) {
+			std::cout << "not same " << x << " -> " << out << "\n";
+			++fail;
+		}
+	}
+	std::cout << "reformat test fail " << fail << "\n";
+	return fail;
+}
+
 void diff_test() {
 	std::cout << "diff test\n";
 
@@ -541,9 +847,49 @@ int main(int argc, char* argv[])
 
 	if (argc <= 1) {
 		std::cout << "[program name] [json file name] (number of thread) \n";
+		std::cout << "[program name] --coordinates (number of thread) \n";
+		std::cout << "[program name] --numa (number of thread) \n";
+		std::cout << "[program name] --small (number of thread) \n";
+		std::cout << "[program name] --batch (number of thread) \n";
+		std::cout << "[program name] --async (number of thread) \n";
+		std::cout << "[program name] --stats (number of thread) \n";
+		std::cout << "[program name] --trace (number of thread) \n";
+		std::cout << "[program name] --reformat-test (number of thread) \n";
 		return 2;
 	}
 
+	if (std::string(argv[1]) == "--coordinates") {
+		coordinates_bench(argc > 2 ? std::atoi(argv[2]) : 0);
+		return 0;
+	}
+	if (std::string(argv[1]) == "--numa") {
+		numa_bench(argc > 2 ? std::atoi(argv[2]) : 0);
+		return 0;
+	}
+	if (std::string(argv[1]) == "--small") {
+		small_bench(argc > 2 ? std::atoi(argv[2]) : 0);
+		return 0;
+	}
+	if (std::string(argv[1]) == "--batch") {
+		batch_bench(argc > 2 ? std::atoi(argv[2]) : 0);
+		return 0;
+	}
+	if (std::string(argv[1]) == "--async") {
+		async_bench(argc > 2 ? std::atoi(argv[2]) : 0);
+		return 0;
+	}
+	if (std::string(argv[1]) == "--stats") {
+		stats_bench(argc > 2 ? std::atoi(argv[2]) : 0);
+		return 0;
+	}
+	if (std::string(argv[1]) == "--trace") {
+		trace_bench(argc > 2 ? std::atoi(argv[2]) : 0);
+		return 0;
+	}
+	if (std::string(argv[1]) == "--reformat-test") {
+		return reformat_test(argc > 2 ? std::atoi(argv[2]) : 0) == 0 ? 0 : 1;
+	}
+
 	diff_test();
 	std::cout << "----------\n";
 	//diff_test2();
@@ -732,6 +1078,13 @@ int main(int argc, char* argv[])
 			w.write_parallel(d.GetAllocator(), "temp.json", j.Get(), thr_num, true);
 		}
 		std::cout << "write_parallel " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - c).count() << "ms\n";
+
+		// same, without tree.
+		{
+			auto a = std::chrono::steady_clock::now();
+			bool ok = p.reformat(argv[1], "temp2.json", true, thr_num);
+			std::cout << "reformat " << ok << " " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - a).count() << "ms\n";
+		}
 	//	std::cout << "counter " << claujson::Arena::counter << "\n";
 
 		if (1) {
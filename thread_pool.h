@@ -2,170 +2,553 @@
 #define THREAD_POOL_H
 
 #include <vector>
-#include <queue>
+#include <deque>
 #include <memory>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <exception>
+#include <chrono>
+#include <type_traits>
+#include <algorithm>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
-#if __cplusplus >= 201703L
+// work-stealing pool.
+//  each worker has a deque (owner push/pop at bottom without lock, others steal at top),
+//  enqueue from outside the pool goes to a shared FIFO queue, so tasks enqueued by one thread start in order.
+//  parallel_for splits range in halves, tasks are on the caller`s stack (no allocation), caller runs or helps until done.
+//  optional : worker i is pinned to cpus[i] and belongs to NUMA node nodes[i], each node has a queue. (parallel_for_node)
 class ThreadPool {
 public:
-    ThreadPool(size_t);
+    ThreadPool(size_t threads, const std::vector<int>& cpus = std::vector<int>(), const std::vector<int>& nodes = std::vector<int>());
+    ~ThreadPool();
+
     template<class F, class... Args>
-    auto enqueue(F f, Args&&... args) 
+#if __cplusplus >= 201703L
+    auto enqueue(F f, Args&&... args)
         -> std::future<typename std::invoke_result<F, Args...>::type>;
-    ~ThreadPool();
+#else
+    auto enqueue(F&& f, Args&&... args)
+        -> std::future<typename std::result_of<F(Args...)>::type>;
+#endif
+
+    // f(i) for i in [begin, end), returns when all are done. (rethrows first exception)
+    //  grain : max number of i in one task.
+    template<class F>
+    void parallel_for(size_t begin, size_t end, F&& f, size_t grain = 1);
+
+    // same, but at most `budget` threads (caller included) run f at the same time, 0 : no limit.
+    //  each of them takes next i in order.
+    template<class F>
+    void parallel_for_budget(size_t begin, size_t end, size_t budget, F&& f);
+
+    // same, but f(i) goes to queue of node node_of(i), workers of that node take it first.
+    //  (idle workers of other nodes take it too)
+    template<class N, class F>
+    void parallel_for_node(size_t begin, size_t end, N&& node_of, F&& f);
+
+    size_t size() const { return workers.size(); }
+    // index of this thread in workers, -1 if it is not a worker of this pool.
+    int64_t worker_index() const {
+        const Local& me = local();
+        return me.pool == this ? static_cast<int64_t>(me.idx) : -1;
+    }
+    size_t node_count() const { return node_tasks.size(); }
+
 private:
-    // need to keep track of threads so we can join them
-    std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
-    
-    // synchronization
+    struct Task {
+        virtual void run() = 0;
+    protected:
+        ~Task() = default;
+    };
+
+    // Chase-Lev deque, fixed capacity. (full -> caller uses shared queue)
+    class WorkDeque {
+    public:
+        static const int64_t capacity = 1 << 10;
+
+        bool push(Task* x) {
+            const int64_t b = bottom.load(std::memory_order_relaxed);
+            const int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= capacity) {
+                return false;
+            }
+            buffer[b & (capacity - 1)].store(x, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_release); // x is visible to steal after this.
+            return true;
+        }
+
+        Task* pop() {
+            const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+
+            Task* x = nullptr;
+            if (t <= b) {
+                x = buffer[b & (capacity - 1)].load(std::memory_order_relaxed);
+                if (t == b) { // last one, race with steal.
+                    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                        x = nullptr;
+                    }
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                }
+            }
+            else {
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return x;
+        }
+
+        Task* steal() {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t b = bottom.load(std::memory_order_acquire);
+
+            if (t < b) {
+                Task* x = buffer[t & (capacity - 1)].load(std::memory_order_relaxed);
+                if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    return x;
+                }
+            }
+            return nullptr;
+        }
+
+    private:
+        std::atomic<int64_t> top{ 0 };
+        char pad0[64 - sizeof(std::atomic<int64_t>)]; // top and bottom in other cache lines.
+        std::atomic<int64_t> bottom{ 0 };
+        char pad1[64 - sizeof(std::atomic<int64_t>)];
+        std::atomic<Task*> buffer[capacity];
+    };
+
+    template<class R>
+    struct FunctionTask : Task {
+        std::packaged_task<R()> task;
+        explicit FunctionTask(std::packaged_task<R()>&& task) : task(std::move(task)) { }
+        void run() override {
+            task();
+            delete this;
+        }
+    };
+
+    template<class F>
+    struct RangeTask : Task {
+        ThreadPool* pool;
+        F* f;
+        size_t begin, end, grain;
+        std::exception_ptr* error;
+        std::atomic<bool> done{ false };
+
+        RangeTask(ThreadPool* pool, F* f, size_t begin, size_t end, size_t grain, std::exception_ptr* error)
+            : pool(pool), f(f), begin(begin), end(end), grain(grain), error(error) { }
+
+        void run() override {
+            ThreadPool* p = pool; // this can be gone after done.
+            p->split(*f, begin, end, grain, error);
+            done.store(true, std::memory_order_release);
+            p->notify_done();
+        }
+    };
+
+    template<class F>
+    struct ItemTask : Task {
+        ThreadPool* pool;
+        F* f;
+        size_t i;
+        std::exception_ptr* error;
+        std::atomic<size_t>* remain;
+
+        ItemTask(ThreadPool* pool, F* f, size_t i, std::exception_ptr* error, std::atomic<size_t>* remain)
+            : pool(pool), f(f), i(i), error(error), remain(remain) { }
+
+        void run() override {
+            ThreadPool* p = pool;
+            p->call(*f, i, error);
+            remain->fetch_sub(1, std::memory_order_release);
+            p->notify_done();
+        }
+    };
+
+    struct NodeQueue {
+        std::mutex mutex;
+        std::deque<Task*> tasks;
+    };
+
+    // worker index of this thread in `pool`, -1 if not a worker of it.
+    struct Local {
+        ThreadPool* pool = nullptr;
+        size_t idx = 0;
+    };
+    static Local& local() {
+        static thread_local Local x;
+        return x;
+    }
+
+    void push(Task* x);
+    void push_node(Task* x, size_t node);
+    Task* pop_node(size_t node);
+    Task* find_task(bool shared);
+    void work(size_t idx);
+    void notify_done();
+
+    template<class F>
+    void call(F& f, size_t i, std::exception_ptr* error);
+    template<class F>
+    void split(F& f, size_t begin, size_t end, size_t grain, std::exception_ptr* error);
+    template<class F>
+    void join(RangeTask<F>& x);
+    template<class P>
+    void help_until(P done);
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkDeque>> deques;
+
+    std::vector<int> worker_cpu; // empty : not pinned.
+    std::vector<size_t> worker_node;
+    std::vector<std::unique_ptr<NodeQueue>> node_tasks;
+
+    // from outside of pool, or deque is full.
+    std::deque<Task*> tasks;
     std::mutex queue_mutex;
     std::condition_variable condition;
+    std::atomic<int64_t> pending{ 0 }; // tasks not taken yet.
+    std::atomic<int> sleeping{ 0 };
+
+    // for join from outside of pool.
+    std::mutex done_mutex;
+    std::condition_variable done_condition;
+    std::atomic<int> joining{ 0 };
+
     bool stop;
 };
- 
-// the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads)
-    :   stop(false)
-{
-    for(size_t i = 0;i<threads;++i)
-        workers.emplace_back(
-            [this]
-            {
-                for(;;)
-                {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this]{ return this->stop || !this->tasks.empty(); });
-                        if(this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
 
-                    task();
-                }
-            }
-        );
+inline ThreadPool::ThreadPool(size_t threads, const std::vector<int>& cpus, const std::vector<int>& nodes)
+    : stop(false)
+{
+    size_t node_num = 1;
+    for (size_t i = 0; i < threads; ++i) {
+        deques.emplace_back(new WorkDeque());
+
+        if (!cpus.empty()) {
+            worker_cpu.push_back(cpus[i % cpus.size()]);
+        }
+        const size_t node = nodes.empty() ? 0 : static_cast<size_t>(nodes[i % nodes.size()]);
+        worker_node.push_back(node);
+        node_num = std::max(node_num, node + 1);
+    }
+    for (size_t i = 0; i < node_num; ++i) {
+        node_tasks.emplace_back(new NodeQueue());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([this, i] { work(i); });
+    }
 }
 
-// add new work item to the pool
-template<class F, class... Args>
-auto ThreadPool::enqueue(F f, Args&&... args) 
-    -> std::future<typename std::invoke_result<F, Args...>::type>
+inline void ThreadPool::push(Task* x)
 {
-    using return_type = typename std::invoke_result<F, Args...>::type;
+    Local& me = local();
 
-    auto task = std::make_shared< std::packaged_task<return_type()> >(
-            std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-        );
-        
-    std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
+    pending.fetch_add(1, std::memory_order_seq_cst);
 
-        // don't allow enqueueing after stopping the pool
-        if(stop)
+    if (me.pool != this || !deques[me.idx]->push(x)) {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        if (stop) {
+            pending.fetch_sub(1, std::memory_order_seq_cst);
             throw std::runtime_error("enqueue on stopped ThreadPool");
+        }
+        tasks.push_back(x);
+    }
 
-        tasks.emplace([task](){ (*task)(); });
+    if (sleeping.load(std::memory_order_seq_cst) > 0) {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        condition.notify_one();
     }
-    condition.notify_one();
-    return res;
 }
 
-// the destructor joins all threads
-inline ThreadPool::~ThreadPool()
+// no notify, caller wakes workers after pushing all.
+inline void ThreadPool::push_node(Task* x, size_t node)
 {
-    {
-        std::unique_lock<std::mutex> lock(queue_mutex);
-        stop = true;
+    pending.fetch_add(1, std::memory_order_seq_cst);
+
+    NodeQueue& q = *node_tasks[node];
+    std::unique_lock<std::mutex> lock(q.mutex);
+    q.tasks.push_back(x);
+}
+
+inline ThreadPool::Task* ThreadPool::pop_node(size_t node)
+{
+    NodeQueue& q = *node_tasks[node];
+    std::unique_lock<std::mutex> lock(q.mutex);
+    if (q.tasks.empty()) {
+        return nullptr;
     }
-    condition.notify_all();
-    for(std::thread &worker: workers)
-        worker.join();
+    Task* x = q.tasks.front();
+    q.tasks.pop_front();
+    return x;
 }
-#else
-class ThreadPool {
-public:
-    ThreadPool(size_t);
-    template<class F, class... Args>
-    auto enqueue(F&& f, Args&&... args)
-        -> std::future<typename std::result_of<F(Args...)>::type>;
-    ~ThreadPool();
-private:
-    // need to keep track of threads so we can join them
-    std::vector< std::thread > workers;
-    // the task queue
-    std::queue< std::function<void()> > tasks;
 
-    // synchronization
-    std::mutex queue_mutex;
-    std::condition_variable condition;
-    bool stop;
-};
+// own deque -> own node queue -> shared queue (if `shared`) -> steal from others -> other node queues.
+inline ThreadPool::Task* ThreadPool::find_task(bool shared)
+{
+    Local& me = local();
+    const bool is_worker = me.pool == this;
 
-// the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads)
-    : stop(false)
+    Task* x = nullptr;
+
+    if (is_worker) {
+        x = deques[me.idx]->pop();
+    }
+    if (!x && is_worker && node_tasks.size() > 1 && pending.load(std::memory_order_relaxed) > 0) {
+        x = pop_node(worker_node[me.idx]);
+    }
+    if (!x && shared && pending.load(std::memory_order_relaxed) > 0) {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        if (!tasks.empty()) {
+            x = tasks.front();
+            tasks.pop_front();
+        }
+    }
+    if (!x) {
+        const size_t n = deques.size();
+        const size_t start = is_worker ? me.idx + 1 : 0;
+        for (size_t i = 0; i < n && !x; ++i) {
+            x = deques[(start + i) % n]->steal();
+        }
+    }
+    if (!x && node_tasks.size() > 1 && pending.load(std::memory_order_relaxed) > 0) {
+        for (size_t i = 0; i < node_tasks.size() && !x; ++i) {
+            x = pop_node(i);
+        }
+    }
+
+    if (x) {
+        pending.fetch_sub(1, std::memory_order_seq_cst);
+    }
+    return x;
+}
+
+inline void ThreadPool::work(size_t idx)
 {
-    for (size_t i = 0; i < threads; ++i)
-        workers.emplace_back(
-            [this]
-            {
-                for (;;)
-                {
-                    std::function<void()> task;
-
-                    {
-                        std::unique_lock<std::mutex> lock(this->queue_mutex);
-                        this->condition.wait(lock,
-                            [this] { return this->stop || !this->tasks.empty(); });
-                        if (this->stop && this->tasks.empty())
-                            return;
-                        task = std::move(this->tasks.front());
-                        this->tasks.pop();
-                    }
+    local().pool = this;
+    local().idx = idx;
 
-                    task();
-                }
-            }
-            );
+#if defined(__linux__)
+    if (!worker_cpu.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(worker_cpu[idx], &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set); // fail -> not pinned.
+    }
+#endif
+
+    for (;;) {
+        Task* x = find_task(true);
+        if (x) {
+            x->run();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        sleeping.fetch_add(1, std::memory_order_seq_cst);
+        condition.wait(lock, [this] { return stop || pending.load(std::memory_order_seq_cst) > 0; });
+        sleeping.fetch_sub(1, std::memory_order_seq_cst);
+        if (stop && tasks.empty()) {
+            return;
+        }
+    }
+}
+
+inline void ThreadPool::notify_done()
+{
+    if (joining.load(std::memory_order_seq_cst) > 0) {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done_condition.notify_all();
+    }
 }
 
 // add new work item to the pool
 template<class F, class... Args>
+#if __cplusplus >= 201703L
+auto ThreadPool::enqueue(F f, Args&&... args)
+    -> std::future<typename std::invoke_result<F, Args...>::type>
+{
+    using return_type = typename std::invoke_result<F, Args...>::type;
+#else
 auto ThreadPool::enqueue(F&& f, Args&&... args)
--> std::future<typename std::result_of<F(Args...)>::type>
+    -> std::future<typename std::result_of<F(Args...)>::type>
 {
     using return_type = typename std::result_of<F(Args...)>::type;
+#endif
+
+    auto* task = new FunctionTask<return_type>(std::packaged_task<return_type()>(
+        std::bind(std::forward<F>(f), std::forward<Args>(args)...)));
 
-    auto task = std::make_shared< std::packaged_task<return_type()> >(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...)
-    );
+    std::future<return_type> res = task->task.get_future();
 
-    std::future<return_type> res = task->get_future();
+    try {
+        push(task);
+    }
+    catch (...) {
+        delete task;
+        throw;
+    }
+    return res;
+}
+
+template<class F>
+void ThreadPool::parallel_for(size_t begin, size_t end, F&& f, size_t grain)
+{
+    if (begin >= end) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+
+    std::exception_ptr error;
+    split(f, begin, end, grain, &error);
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+template<class F>
+void ThreadPool::parallel_for_budget(size_t begin, size_t end, size_t budget, F&& f)
+{
+    if (begin >= end) {
+        return;
+    }
+    if (budget == 0 || budget >= end - begin) {
+        parallel_for(begin, end, f);
+        return;
+    }
+
+    std::atomic<size_t> next{ begin };
+    parallel_for(0, budget, [&](size_t) {
+        for (size_t i = next.fetch_add(1); i < end; i = next.fetch_add(1)) {
+            f(i);
+        }
+    });
+}
+
+template<class N, class F>
+void ThreadPool::parallel_for_node(size_t begin, size_t end, N&& node_of, F&& f)
+{
+    if (begin >= end) {
+        return;
+    }
+    if (node_tasks.size() <= 1 || workers.empty()) {
+        parallel_for(begin, end, f);
+        return;
+    }
+
+    using Item = ItemTask<typename std::remove_reference<F>::type>;
+
+    std::exception_ptr error;
+    std::atomic<size_t> remain{ end - begin };
+    std::vector<Item> items;
+    items.reserve(end - begin);
+
+    for (size_t i = begin; i < end; ++i) {
+        items.emplace_back(this, &f, i, &error, &remain);
+    }
+    for (Item& x : items) {
+        push_node(&x, static_cast<size_t>(node_of(x.i)) % node_tasks.size());
+    }
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
+        condition.notify_all();
+    }
 
-        // don't allow enqueueing after stopping the pool
-        if (stop)
-            throw std::runtime_error("enqueue on stopped ThreadPool");
+    help_until([&remain] { return remain.load(std::memory_order_acquire) == 0; });
 
-        tasks.emplace([task]() { (*task)(); });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+template<class F>
+void ThreadPool::call(F& f, size_t i, std::exception_ptr* error)
+{
+    try {
+        f(i);
+    }
+    catch (...) {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        if (!*error) {
+            *error = std::current_exception();
+        }
+    }
+}
+
+// right half -> task, left half -> here.
+template<class F>
+void ThreadPool::split(F& f, size_t begin, size_t end, size_t grain, std::exception_ptr* error)
+{
+    if (end - begin > grain && !workers.empty()) {
+        const size_t middle = begin + (end - begin) / 2;
+
+        RangeTask<F> right(this, &f, middle, end, grain, error);
+        push(&right);
+
+        split(f, begin, middle, grain, error);
+
+        join(right);
+        return;
+    }
+
+    for (size_t i = begin; i < end; ++i) {
+        call(f, i, error);
+    }
+}
+
+// help until x is done. (x is on this stack, it can not be left)
+template<class F>
+void ThreadPool::join(RangeTask<F>& x)
+{
+    const bool is_worker = local().pool == this;
+
+    if (!is_worker) { // x is not taken yet -> run here.
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        if (!tasks.empty() && tasks.back() == &x) {
+            tasks.pop_back();
+            lock.unlock();
+            pending.fetch_sub(1, std::memory_order_seq_cst);
+            x.run();
+            return;
+        }
+    }
+
+    help_until([&x] { return x.done.load(std::memory_order_acquire); });
+}
+
+template<class P>
+void ThreadPool::help_until(P done)
+{
+    const bool is_worker = local().pool == this;
+
+    while (!done()) {
+        // worker : any task, outside : only tasks in deques, not other callers` tasks in shared queue.
+        Task* y = find_task(is_worker);
+        if (y) {
+            y->run();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(done_mutex);
+        joining.fetch_add(1, std::memory_order_seq_cst);
+        done_condition.wait_for(lock, std::chrono::milliseconds(1), done);
+        joining.fetch_sub(1, std::memory_order_seq_cst);
     }
-    condition.notify_one();
-    return res;
 }
 
 // the destructor joins all threads
@@ -176,10 +559,9 @@ inline ThreadPool::~ThreadPool()
         stop = true;
     }
     condition.notify_all();
-    for (std::thread& worker : workers)
+    for (std::thread& worker : workers) {
         worker.join();
+    }
 }
 
 #endif
-
-#endif